@@ -0,0 +1,116 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#if defined (ESP8266)
+  #include <ESP8266WiFi.h>
+#else if defined (ESP32_DEV)
+  #include <WiFi.h>
+#endif
+
+#include <WiFiClient.h>
+#include <WeatherFlowUdp.h>
+#include <WeatherFlowWriter.h>
+
+//WiFi
+const char *ssid = "your_wifi_name";
+const char *password = "your_wifi_password";
+
+// InfluxDB v2 server to write to
+const char *influxHost = "192.168.1.10";
+const uint16_t influxPort = 8086;
+const char *influxPath = "/api/v2/write?org=your_org&bucket=weather&precision=s";
+const char *influxToken = "your_token";
+
+// Construct a WeatherFlow UDP listener
+WeatherFlowUdp currentWeather;
+
+// Records are batched in this buffer until it is sent
+char influxBuffer[1536];
+WeatherFlowWriter influxWriter(influxBuffer, sizeof(influxBuffer));
+
+/*
+Called by the writer with a batch of records in line protocol.
+*/
+void sendToInflux(const char* data, size_t length, void* context) {
+  WiFiClient client;
+  if (!client.connect(influxHost, influxPort)) {
+    Serial.println(F("Failed to connect to InfluxDB"));
+    return;
+  }
+
+  client.print(F("POST "));
+  client.print(influxPath);
+  client.print(F(" HTTP/1.1\r\nHost: "));
+  client.print(influxHost);
+  client.print(F("\r\nAuthorization: Token "));
+  client.print(influxToken);
+  client.print(F("\r\nContent-Type: text/plain\r\nConnection: close\r\nContent-Length: "));
+  client.print(length);
+  client.print(F("\r\n\r\n"));
+  client.write((const uint8_t*)data, length);
+
+  Serial.print(F("Sent "));
+  Serial.print(length);
+  Serial.println(F(" bytes to InfluxDB"));
+  client.stop();
+}
+
+/*
+This function is called everytime a new WeatherFlow object is processed.
+Rapid wind arrives every few seconds, so it is left out.
+*/
+void handleNewObject(WeatherFlowData::Object obj, void* context) {
+  if (obj != WeatherFlowData::WIND)
+    influxWriter.write(currentWeather, obj);
+}
+
+void setup() {
+	Serial.begin ( 115200 );
+	WiFi.begin ( ssid, password );
+	Serial.println ( "" );
+  Serial.print ( F("Connecting to WiFi "));
+
+	// Wait for connection
+	while ( WiFi.status() != WL_CONNECTED ) {
+		delay ( 500 );
+		Serial.print ( F(".") );
+	}
+
+	Serial.println ( F("") );
+	Serial.print (F("Connected to ") );
+	Serial.println ( ssid );
+	Serial.print ( F("IP address: ") );
+	Serial.println ( WiFi.localIP() );
+
+  // Send a batch every 10 records, or at least once a minute
+  influxWriter.registerFlush(sendToInflux);
+  influxWriter.setBatchSize(10);
+  influxWriter.setFlushInterval(60000);
+
+  // Setup to listen for WeatherFlow UDP packets
+  currentWeather.registerCallback(handleNewObject);
+  currentWeather.begin();
+}
+
+void loop() {
+  currentWeather.update();
+  influxWriter.update();
+}
@@ -30,6 +30,8 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <WiFiClient.h>
 #include <WeatherFlowUdp.h>
 #include <WeatherFlowStrings.h>
+#include <WeatherFlowEventStream.h>
+#include <WeatherFlowHeap.h>
 
 //WiFi
 const char *ssid = "your_wifi_name";
@@ -45,6 +47,8 @@ WeatherFlowUdp currentWeather;
   WebServer server ( 80 );
 #endif
 
+// Push each new object to live dashboards as Server-Sent Events
+WeatherFlowEventStream liveEvents ( 81 );
 
 /*
 This function is called everytime a new WeatherFlow object is processed. The
@@ -54,6 +58,20 @@ void handleNewObject(WeatherFlowData::Object obj, void* context) {
   // Print out that an object has been recieved
   Serial.print(F("Received new object: "));
   Serial.println(WeatherFlowStrings::description_P(obj));
+
+  // Encoded once for all connected dashboards
+  liveEvents.publish(currentWeather, obj);
+}
+
+/*
+This function is called when a device stops reporting, and when it
+starts again. Its values are not published while it is stale.
+*/
+void handleHealth(WeatherFlowData::Object obj, const char *serial, bool stale, void* context) {
+  Serial.print(WeatherFlowStrings::description_P(obj));
+  Serial.print(F(" ("));
+  Serial.print(serial);
+  Serial.println(stale ? F(") stopped reporting") : F(") is reporting again"));
 }
 
 // Send a simple web page that has one link on it, to the Prometheus metrics
@@ -63,6 +81,8 @@ void handleRoot() {
   server.send ( 200, "text/html", "" );
   server.sendContent(F("<html><head>Prometheus Publisher</head><body>"));
   server.sendContent(F("<p><a href=\"metrics\">Prometheus metrics</a></p>"));
+  server.sendContent(F("<p>Live events are streamed on port 81</p>"));
+  server.sendContent(F("<p><a href=\"heap\">JSON heap use</a></p>"));
   server.sendContent(F("Compiled: "));
   server.sendContent(F(__DATE__));
   server.sendContent( F(", "));
@@ -75,6 +95,32 @@ void handleRoot() {
   server.client().stop();
 }
 
+// Send one packet counter for every device that has been heard
+void sendPacketCounter(const __FlashStringHelper *name, const __FlashStringHelper *help, uint32_t WeatherFlowSequence::Device::*counter) {
+  server.sendContent(F("#HELP weather_"));
+  server.sendContent(name);
+  server.sendContent(F(" "));
+  server.sendContent(help);
+  server.sendContent(F("\n#TYPE weather_"));
+  server.sendContent(name);
+  server.sendContent(F(" counter\n"));
+  for (int i = 0; i < currentWeather.deviceCount(); i++) {
+    const WeatherFlowSequence::Device& device = currentWeather.deviceStats(i);
+    WeatherFlowData::Object obj = static_cast<WeatherFlowData::Object>(device.type);
+    server.sendContent(F("weather_"));
+    server.sendContent(name);
+    server.sendContent(F("{serial=\""));
+    server.sendContent(device.serial);
+    server.sendContent(F("\",object=\""));
+    server.sendContent(WeatherFlowStrings::description_P(obj));
+    server.sendContent(F("\"} "));
+    char buffer[12];
+    sprintf(buffer, "%lu", (unsigned long)(device.*counter));
+    server.sendContent(buffer);
+    server.sendContent(F("\n"));
+  }
+}
+
 void handleMetrics() {
   Serial.println(F("Handling a metrics request"));
   server.setContentLength(CONTENT_LENGTH_UNKNOWN);
@@ -151,6 +197,67 @@ void handleMetrics() {
 
   }
 
+  // Packet statistics for each device
+  sendPacketCounter(F("packets_received"), F("Packets received from the device"), &WeatherFlowSequence::Device::received);
+  sendPacketCounter(F("packets_lost"), F("Packets from the device that never arrived"), &WeatherFlowSequence::Device::lost);
+  sendPacketCounter(F("packets_late"), F("Packets from the device that arrived out of order"), &WeatherFlowSequence::Device::late);
+
+  // 1 if the device is reporting, 0 if it has stopped
+  server.sendContent(F("#HELP weather_device_up Device has reported within its expected interval\n"));
+  server.sendContent(F("#TYPE weather_device_up gauge\n"));
+  for (int i = 0; i < currentWeather.healthCount(); i++) {
+    const WeatherFlowWatchdog::Device& device = currentWeather.deviceHealth(i);
+    if (device.interval == 0)
+      continue;
+    server.sendContent(F("weather_device_up{serial=\""));
+    server.sendContent(device.serial);
+    server.sendContent(F("\",object=\""));
+    server.sendContent(WeatherFlowStrings::description_P(static_cast<WeatherFlowData::Object>(device.type)));
+    server.sendContent(device.stale ? F("\"} 0\n") : F("\"} 1\n"));
+  }
+
+  server.sendContent(F("#HELP weather_packets_duplicate Packets dropped because they were already processed\n"));
+  server.sendContent(F("#TYPE weather_packets_duplicate counter\n"));
+  server.sendContent(F("weather_packets_duplicate "));
+  char buffer[12];
+  sprintf(buffer, "%lu", (unsigned long)currentWeather.duplicatePackets());
+  server.sendContent(buffer);
+  server.sendContent(F("\n"));
+
+  server.client().stop();
+}
+
+// Sends whatever is printed to it as part of the web server response
+class ContentPrinter : public Print {
+  public:
+    ContentPrinter() : used(0) {}
+    ~ContentPrinter() { flush(); }
+    size_t write(uint8_t c) {
+      buffer[used++] = c;
+      if (used == sizeof(buffer) - 1)
+        flush();
+      return 1;
+    }
+    void flush() {
+      buffer[used] = '\0';
+      if (used)
+        server.sendContent(buffer);
+      used = 0;
+    }
+  private:
+    char buffer[128];
+    size_t used;
+};
+
+// Memory used by the library's JSON documents, for each call site and
+// object type. Build with WEATHERFLOW_HEAP_PROFILE defined to enable.
+void handleHeap() {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send ( 200, "text/plain", "" );
+  {
+    ContentPrinter out;
+    WeatherFlowHeap::instance()->printTo(out);
+  }
   server.client().stop();
 }
 
@@ -174,15 +281,19 @@ void setup() {
 
   // Setup to listen for WeatherFlow UDP packets 
   currentWeather.registerCallback(handleNewObject);
+  currentWeather.registerHealthCallback(handleHealth);
   currentWeather.begin();
 
   // Setup web server pages
 	server.on ( "/", handleRoot );
   server.on ( "/metrics", handleMetrics );
+  server.on ( "/heap", handleHeap );
   server.begin();
+  liveEvents.begin();
 }
 
 void loop() {
   currentWeather.update();
   server.handleClient();  
+  liveEvents.update();
 }
@@ -0,0 +1,159 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+Soak test: a TrafficGenerator sends synthetic WeatherFlow packets to
+this node's own WeatherFlowUdp listener over loopback, and every
+report interval the latency from send to callback, the packets
+dropped and the free heap are printed. Increase the stations and
+rates until packets start to go missing to find how many stations
+one node can handle.
+*/
+
+#if defined (ESP8266)
+  #include <ESP8266WiFi.h>
+#else if defined (ESP32_DEV)
+  #include <WiFi.h>
+#endif
+
+#include <WiFiClient.h>
+#include <WeatherFlowUdp.h>
+#include <WeatherFlowStrings.h>
+#include "TrafficGenerator.h"
+
+//WiFi
+const char *ssid = "your_wifi_name";
+const char *password = "your_wifi_password";
+
+// Milliseconds between reports
+#define REPORT_INTERVAL (10000)
+
+// Construct a WeatherFlow UDP listener and the traffic generator
+WeatherFlowUdp currentWeather;
+TrafficGenerator generator;
+
+// Latency and heap use since the last report
+unsigned long callbacks = 0;
+unsigned long latencyTotal = 0;
+unsigned long latencyMax = 0;
+uint32_t heapMin = 0xFFFFFFFF;
+uint32_t heapMax = 0;
+unsigned long lastReport = 0;
+
+/*
+Called for every object processed. Find the packet that carried it
+to measure how long it took to arrive.
+*/
+void handleNewObject(WeatherFlowData::Object obj, void* context) {
+  unsigned long latency;
+  const char *serial = currentWeather.getValue(obj, WeatherFlowData::Serial_Number);
+  uint32_t time = currentWeather.getValue(obj, WeatherFlowData::Time_Epoch);
+  callbacks++;
+  if (generator.received(serial, obj, time, latency)) {
+    latencyTotal += latency;
+    if (latency > latencyMax)
+      latencyMax = latency;
+  }
+}
+
+void report() {
+  const TrafficGenerator::Stats &stats = generator.stats();
+  uint32_t lost = 0;
+  uint32_t late = 0;
+  for (int i = 0; i < currentWeather.deviceCount(); i++) {
+    lost += currentWeather.deviceStats(i).lost;
+    late += currentWeather.deviceStats(i).late;
+  }
+
+  Serial.print(F("sent ")); Serial.print(stats.sent);
+  Serial.print(F(" callbacks ")); Serial.print(callbacks);
+  Serial.print(F(" matched ")); Serial.print(stats.matched);
+  Serial.print(F(" missing ")); Serial.println(stats.missing);
+  Serial.print(F("  injected: duplicates ")); Serial.print(stats.duplicates);
+  Serial.print(F(" reordered ")); Serial.print(stats.reordered);
+  Serial.print(F(" malformed ")); Serial.println(stats.malformed);
+  Serial.print(F("  library: duplicates ")); Serial.print(currentWeather.duplicatePackets());
+  Serial.print(F(" late ")); Serial.print(late);
+  Serial.print(F(" lost ")); Serial.println(lost);
+  Serial.print(F("  latency us: average "));
+  Serial.print(stats.matched ? latencyTotal / stats.matched : 0);
+  Serial.print(F(" max ")); Serial.println(latencyMax);
+  Serial.print(F("  free heap: min ")); Serial.print(heapMin);
+  Serial.print(F(" max ")); Serial.println(heapMax);
+
+  // Latency and heap are reported per interval, counts are totals
+  latencyMax = 0;
+  heapMin = 0xFFFFFFFF;
+  heapMax = 0;
+}
+
+void setup() {
+  Serial.begin ( 115200 );
+  WiFi.begin ( ssid, password );
+  Serial.println ( "" );
+  Serial.print ( F("Connecting to WiFi "));
+
+  // Wait for connection
+  while ( WiFi.status() != WL_CONNECTED ) {
+    delay ( 500 );
+    Serial.print ( F(".") );
+  }
+
+  Serial.println ( F("") );
+  Serial.print (F("Connected to ") );
+  Serial.println ( ssid );
+
+  // Listen for the generated packets
+  currentWeather.registerCallback(handleNewObject);
+  currentWeather.begin();
+
+  // Traffic to send: change these to find the limits
+  TrafficGenerator::Config config;
+  config.stations = 8;
+  config.hubs = 2;
+  config.obsInterval = 1000;
+  config.windInterval = 200;
+  config.statusInterval = 5000;
+  config.hubInterval = 1000;
+  config.burstInterval = 30000;
+  config.burstSize = 10;
+  config.duplicatePercent = 5;
+  config.reorderPercent = 2;
+  config.malformedPercent = 1;
+  generator.begin(config, IPAddress(127, 0, 0, 1), WEATHERFLOW_UDP_PORT);
+  lastReport = millis();
+}
+
+void loop() {
+  generator.update();
+  currentWeather.update();
+
+  uint32_t heap = ESP.getFreeHeap();
+  if (heap < heapMin)
+    heapMin = heap;
+  if (heap > heapMax)
+    heapMax = heap;
+
+  if (millis() - lastReport >= REPORT_INTERVAL) {
+    lastReport = millis();
+    report();
+  }
+}
@@ -0,0 +1,315 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "TrafficGenerator.h"
+
+// Time of the first simulated packet
+#define START_EPOCH (1700000000UL)
+
+TrafficGenerator::TrafficGenerator() :
+  port(0),
+  nextBurst(0),
+  heldLength(0),
+  pendingNext(0)
+  {
+  memset(pending, 0, sizeof(pending));
+  resetStats();
+}
+
+void TrafficGenerator::begin(const Config &newConfig, IPAddress newAddress, uint16_t newPort) {
+  config = newConfig;
+  if (config.stations > TRAFFIC_MAX_STATIONS)
+    config.stations = TRAFFIC_MAX_STATIONS;
+  if (config.hubs > TRAFFIC_MAX_HUBS)
+    config.hubs = TRAFFIC_MAX_HUBS;
+  if (config.hubs < 1)
+    config.hubs = 1;
+  address = newAddress;
+  port = newPort;
+  udp.begin(0);
+
+  // Spread the first packets over an interval so they do not all
+  // arrive at once
+  unsigned long now = millis();
+  for (int i = 0; i < config.hubs; i++) {
+    Hub &hub = hubs[i];
+    snprintf(hub.serial, sizeof(hub.serial), "HB-%08d", i + 1);
+    hub.time = START_EPOCH;
+    hub.sequence = 0;
+    hub.next = now + random(config.hubInterval + 1);
+  }
+  for (int i = 0; i < config.stations; i++) {
+    Station &station = stations[i];
+    snprintf(station.serial, sizeof(station.serial), "ST-%08d", i + 1);
+    station.hub = i % config.hubs;
+    station.obsTime = START_EPOCH;
+    station.windTime = START_EPOCH;
+    station.statusTime = START_EPOCH;
+    station.eventTime = START_EPOCH;
+    station.nextObs = now + random(config.obsInterval + 1);
+    station.nextWind = now + random(config.windInterval + 1);
+    station.nextStatus = now + random(config.statusInterval + 1);
+  }
+  nextBurst = now + config.burstInterval;
+}
+
+void TrafficGenerator::resetStats() {
+  memset(&counts, 0, sizeof(counts));
+}
+
+// True, and moves next on, if an interval has passed
+bool TrafficGenerator::due(unsigned long &next, unsigned long interval, unsigned long now) {
+  if (interval == 0 || (long)(now - next) < 0)
+    return false;
+  next += interval;
+  // Do not try to catch up after falling far behind
+  if ((long)(now - next) > (long)interval)
+    next = now + interval;
+  return true;
+}
+
+void TrafficGenerator::update() {
+  if (!port)
+    return;
+  unsigned long now = millis();
+
+  for (int i = 0; i < config.hubs; i++) {
+    if (due(hubs[i].next, config.hubInterval, now))
+      sendHub(hubs[i]);
+  }
+
+  bool burst = config.burstSize > 0 && due(nextBurst, config.burstInterval, now);
+  for (int i = 0; i < config.stations; i++) {
+    Station &station = stations[i];
+    if (due(station.nextObs, config.obsInterval, now)) {
+      sendObservation(station);
+      if (random(100) < config.strikePercent)
+        sendStrike(station);
+      if (random(100) < config.precipPercent)
+        sendPrecip(station);
+    }
+    if (due(station.nextWind, config.windInterval, now))
+      sendWind(station);
+    if (due(station.nextStatus, config.statusInterval, now))
+      sendStatus(station);
+    for (int b = 0; burst && b < config.burstSize; b++)
+      sendWind(station);
+  }
+
+  expire();
+}
+
+void TrafficGenerator::sendObservation(Station &station) {
+  station.obsTime += 60;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"obs_st\",\"hub_sn\":\"%s\","
+    "\"obs\":[[%lu,%d.%02d,%d.%02d,%d.%02d,%d,3,%d.%02d,%d.%02d,%d.%02d,%d,%d.%02d,%d,%d.%06d,%d,%d,%d,2.%03d,1]],"
+    "\"firmware_revision\":129}",
+    station.serial, hubs[station.hub].serial, (unsigned long)station.obsTime,
+    (int)random(3), (int)random(100),      // wind lull
+    (int)random(3, 6), (int)random(100),   // wind average
+    (int)random(6, 12), (int)random(100),  // wind gust
+    (int)random(360),                      // direction
+    (int)random(990, 1030), (int)random(100),  // pressure
+    (int)random(-10, 35), (int)random(100),    // temperature
+    (int)random(20, 99), (int)random(100),     // humidity
+    (int)random(100000),                   // illuminance
+    (int)random(12), (int)random(100),     // UV
+    (int)random(1200),                     // solar radiation
+    0, random(10) ? 0 : (int)random(1000000),  // rain in the last minute
+    (int)random(3),                        // precipitation type
+    (int)random(40),                       // strike distance
+    (int)random(3),                        // strike count
+    (int)random(300, 800));                // battery
+  emit(station.serial, WeatherFlowData::TEMPEST, station.obsTime, length);
+}
+
+void TrafficGenerator::sendWind(Station &station) {
+  station.windTime += 3;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"rapid_wind\",\"hub_sn\":\"%s\",\"ob\":[%lu,%d.%02d,%d]}",
+    station.serial, hubs[station.hub].serial, (unsigned long)station.windTime,
+    (int)random(12), (int)random(100), (int)random(360));
+  emit(station.serial, WeatherFlowData::WIND, station.windTime, length);
+}
+
+void TrafficGenerator::sendStatus(Station &station) {
+  station.statusTime += 60;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"device_status\",\"hub_sn\":\"%s\","
+    "\"timestamp\":%lu,\"uptime\":%lu,\"voltage\":2.%03d,\"firmware_revision\":129,"
+    "\"rssi\":%d,\"hub_rssi\":%d,\"sensor_status\":0,\"debug\":0}",
+    station.serial, hubs[station.hub].serial, (unsigned long)station.statusTime,
+    (unsigned long)(station.statusTime - START_EPOCH), (int)random(300, 800),
+    (int)-random(40, 90), (int)-random(40, 90));
+  emit(station.serial, WeatherFlowData::STATUS, station.statusTime, length);
+}
+
+void TrafficGenerator::sendStrike(Station &station) {
+  station.eventTime++;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"evt_strike\",\"hub_sn\":\"%s\",\"evt\":[%lu,%d,%d]}",
+    station.serial, hubs[station.hub].serial, (unsigned long)station.eventTime,
+    (int)random(1, 40), (int)random(1000, 5000));
+  emit(station.serial, WeatherFlowData::LIGHTNING, station.eventTime, length);
+}
+
+void TrafficGenerator::sendPrecip(Station &station) {
+  station.eventTime++;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"evt_precip\",\"hub_sn\":\"%s\",\"evt\":[%lu]}",
+    station.serial, hubs[station.hub].serial, (unsigned long)station.eventTime);
+  emit(station.serial, WeatherFlowData::RAIN, station.eventTime, length);
+}
+
+void TrafficGenerator::sendHub(Hub &hub) {
+  hub.time += 10;
+  hub.sequence++;
+  int length = snprintf(packet, sizeof(packet),
+    "{\"serial_number\":\"%s\",\"type\":\"hub_status\",\"firmware_revision\":\"171\","
+    "\"uptime\":%lu,\"rssi\":%d,\"timestamp\":%lu,\"reset_flags\":\"BOR,PIN,POR\",\"seq\":%lu,"
+    "\"radio_stats\":[25,1,0,3,%d]}",
+    hub.serial, (unsigned long)(hub.time - START_EPOCH), (int)-random(40, 90),
+    (unsigned long)hub.time, (unsigned long)hub.sequence, (int)random(10000));
+  emit(hub.serial, WeatherFlowData::HUB, hub.time, length);
+}
+
+// Replace a randomly chosen brace, bracket, colon or comma outside
+// the strings, so the packet cannot still be valid JSON
+static void breakStructure(char *data, int length) {
+  int count = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    int target = pass ? random(count) : -1;
+    bool inString = false;
+    int found = 0;
+    for (int i = 0; i < length; i++) {
+      char c = data[i];
+      if (inString) {
+        if (c == '\\')
+          i++;
+        else if (c == '"')
+          inString = false;
+      } else if (c == '"') {
+        inString = true;
+      } else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') {
+        if (found++ == target) {
+          data[i] = '#';
+          return;
+        }
+      }
+    }
+    count = found;
+    if (count == 0)
+      return;
+  }
+}
+
+// Send the packet in packet[], mixing in the faults asked for
+void TrafficGenerator::emit(const char *serial, WeatherFlowData::Object obj, uint32_t time, int length) {
+  if (length <= 0 || length >= (int)sizeof(packet))
+    return;
+
+  if (random(100) < config.malformedPercent) {
+    // Cut the packet short, or break its structure
+    if (random(2))
+      length = random(1, length);
+    else
+      breakStructure(packet, length);
+    transmit(packet, length);
+    counts.malformed++;
+    return;
+  }
+
+  // Events are not ordered by the listener, so only periodic packets
+  // are held back
+  bool periodic = obj != WeatherFlowData::RAIN && obj != WeatherFlowData::LIGHTNING;
+  if (!heldLength && periodic && random(100) < config.reorderPercent) {
+    memcpy(held, packet, length);
+    heldLength = length;
+    heldSerial = serial;
+    heldObj = obj;
+    return;
+  }
+
+  track(serial, obj, time);
+  transmit(packet, length);
+  counts.sent++;
+  if (random(100) < config.duplicatePercent) {
+    transmit(packet, length);
+    counts.duplicates++;
+  }
+
+  // The held packet now arrives after a newer one from its device.
+  // It is not tracked, the listener drops it or counts it reordered
+  if (heldLength && obj == heldObj && strcmp(serial, heldSerial) == 0) {
+    transmit(held, heldLength);
+    heldLength = 0;
+    counts.sent++;
+    counts.reordered++;
+  }
+}
+
+void TrafficGenerator::transmit(const char *data, int length) {
+  udp.beginPacket(address, port);
+  udp.write((const uint8_t*)data, length);
+  udp.endPacket();
+}
+
+void TrafficGenerator::track(const char *serial, WeatherFlowData::Object obj, uint32_t time) {
+  Pending &entry = pending[pendingNext];
+  if (entry.used)
+    counts.missing++;
+  entry.serial = serial;
+  entry.obj = obj;
+  entry.time = time;
+  entry.sentMicros = micros();
+  entry.sentMillis = millis();
+  entry.used = true;
+  pendingNext = (pendingNext + 1) % TRAFFIC_PENDING;
+}
+
+bool TrafficGenerator::received(const char *serial, WeatherFlowData::Object obj, uint32_t time, unsigned long &latencyMicros) {
+  if (!serial)
+    return false;
+  for (int i = 0; i < TRAFFIC_PENDING; i++) {
+    Pending &entry = pending[i];
+    if (entry.used && entry.obj == obj && entry.time == time && strcmp(entry.serial, serial) == 0) {
+      latencyMicros = micros() - entry.sentMicros;
+      entry.used = false;
+      counts.matched++;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Packets that have not been processed in time were lost, or were
+// dropped as late
+void TrafficGenerator::expire() {
+  unsigned long now = millis();
+  for (int i = 0; i < TRAFFIC_PENDING; i++) {
+    Pending &entry = pending[i];
+    if (entry.used && now - entry.sentMillis > TRAFFIC_PENDING_TIMEOUT) {
+      entry.used = false;
+      counts.missing++;
+    }
+  }
+}
@@ -0,0 +1,162 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _TrafficGenerator_H
+#define _TrafficGenerator_H
+
+/***
+    Sends synthetic WeatherFlow packets, as a number of simulated
+    Tempest stations and hubs would, to a WeatherFlowUdp listener.
+
+    Each station sends obs_st, rapid_wind and device_status packets,
+    with the occasional evt_strike and evt_precip, and each hub sends
+    hub_status. Times in the packets advance by the interval each
+    packet would normally have, so packets can be sent much faster
+    than real time and still look like a continuous stream.
+
+    Duplicates, packets held back and sent after a newer one from the
+    same device, and malformed packets can be mixed in. Every well
+    formed packet sent in order is remembered for a short time so
+    that its latency can be found when the callback for it is called;
+    held packets are not, as the listener only keeps the newest.
+ */
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <WeatherFlowData.h>
+
+#define TRAFFIC_MAX_STATIONS (64)
+#define TRAFFIC_MAX_HUBS (8)
+#define TRAFFIC_PACKET_SIZE (512)
+// Packets remembered for latency measurement
+#define TRAFFIC_PENDING (128)
+// Milliseconds before a remembered packet counts as missing
+#define TRAFFIC_PENDING_TIMEOUT (5000)
+
+class TrafficGenerator {
+  public:
+    /* Traffic to generate. Intervals are in milliseconds, 0 to not
+       send that packet; percentages are per packet */
+    struct Config {
+      int stations = 4;
+      int hubs = 1;
+      unsigned long obsInterval = 60000;
+      unsigned long windInterval = 3000;
+      unsigned long statusInterval = 60000;
+      unsigned long hubInterval = 10000;
+      uint8_t strikePercent = 5;     // evt_strike after an obs_st
+      uint8_t precipPercent = 2;     // evt_precip after an obs_st
+      unsigned long burstInterval = 0;  // every station sends burstSize rapid_wind
+      int burstSize = 0;
+      uint8_t duplicatePercent = 0;
+      uint8_t reorderPercent = 0;
+      uint8_t malformedPercent = 0;
+    };
+
+    struct Stats {
+      uint32_t sent;        // Well formed packets, including held ones
+      uint32_t duplicates;  // Extra copies sent
+      uint32_t reordered;   // Packets sent after a newer one
+      uint32_t malformed;   // Packets corrupted before sending
+      uint32_t matched;     // Sent packets whose callback was seen
+      uint32_t missing;     // Sent packets with no callback in time
+    };
+
+    TrafficGenerator();
+
+    /* Start sending to address:port */
+    void begin(const Config &config, IPAddress address, uint16_t port = 50222);
+
+    /* Send every packet that is due. Call from loop() */
+    void update();
+
+    /* Called from the WeatherFlowData callback: finds the packet
+       that was sent for serial, obj and time. Returns false if it was
+       not sent by the generator, or was already matched */
+    bool received(const char *serial, WeatherFlowData::Object obj, uint32_t time, unsigned long &latencyMicros);
+
+    const Stats &stats() const { return counts; }
+    void resetStats();
+
+  private:
+    struct Station {
+      char serial[16];
+      int hub;
+      uint32_t obsTime;
+      uint32_t windTime;
+      uint32_t statusTime;
+      uint32_t eventTime;
+      unsigned long nextObs;
+      unsigned long nextWind;
+      unsigned long nextStatus;
+    };
+
+    struct Hub {
+      char serial[16];
+      uint32_t time;
+      uint32_t sequence;
+      unsigned long next;
+    };
+
+    struct Pending {
+      const char *serial;
+      WeatherFlowData::Object obj;
+      uint32_t time;
+      unsigned long sentMicros;
+      unsigned long sentMillis;
+      bool used;
+    };
+
+    static bool due(unsigned long &next, unsigned long interval, unsigned long now);
+    void sendObservation(Station &station);
+    void sendWind(Station &station);
+    void sendStatus(Station &station);
+    void sendStrike(Station &station);
+    void sendPrecip(Station &station);
+    void sendHub(Hub &hub);
+    void emit(const char *serial, WeatherFlowData::Object obj, uint32_t time, int length);
+    void transmit(const char *packet, int length);
+    void track(const char *serial, WeatherFlowData::Object obj, uint32_t time);
+    void expire();
+
+    Config config;
+    IPAddress address;
+    uint16_t port;
+    WiFiUDP udp;
+
+    Station stations[TRAFFIC_MAX_STATIONS];
+    Hub hubs[TRAFFIC_MAX_HUBS];
+    unsigned long nextBurst;
+
+    char packet[TRAFFIC_PACKET_SIZE];
+
+    // A packet held back to be sent after the next one of the same
+    // device and type
+    char held[TRAFFIC_PACKET_SIZE];
+    int heldLength;
+    const char *heldSerial;
+    WeatherFlowData::Object heldObj;
+
+    Pending pending[TRAFFIC_PENDING];
+    int pendingNext;
+
+    Stats counts;
+};
+#endif
@@ -0,0 +1,98 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+#include <time.h>
+
+HardwareSerial Serial;
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(long value, int base) {
+	if (base == DEC) {
+		char digits[24];
+		snprintf(digits, sizeof(digits), "%ld", value);
+		return write(digits);
+	}
+	return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+	char digits[8 * sizeof(long) + 1];
+	if (base == HEX)
+		snprintf(digits, sizeof(digits), "%lX", value);
+	else
+		snprintf(digits, sizeof(digits), "%lu", value);
+	return write(digits);
+}
+
+size_t Print::print(double value, int digits) {
+	char text[48];
+	snprintf(text, sizeof(text), "%.*f", digits, value);
+	return write(text);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+	return fwrite(buffer, 1, size, stdout);
+}
+
+static uint64_t monotonicMicros() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static const uint64_t startMicros = monotonicMicros();
+
+unsigned long millis() {
+	return (unsigned long)((monotonicMicros() - startMicros) / 1000);
+}
+
+unsigned long micros() {
+	return (unsigned long)(monotonicMicros() - startMicros);
+}
+
+void delay(unsigned long ms) {
+	struct timespec wait = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+	nanosleep(&wait, 0);
+}
+
+long random(long max) {
+	return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max) {
+	return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+	if (seed)
+		srandom(seed);
+}
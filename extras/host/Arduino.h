@@ -0,0 +1,98 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _Arduino_H
+#define _Arduino_H
+
+/***
+    The parts of the Arduino core used by WeatherFlowData and
+    WeatherFlowAsync, so that they build on a Linux host. Flash
+    strings are ordinary strings and Serial writes to stdout.
+
+    Not needed, and not seen, when building for a board.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <functional>
+
+#define DEC 10
+#define HEX 16
+
+// Program memory is ordinary memory
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define PSTR(s) (s)
+#define PROGMEM
+typedef const char *PGM_P;
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+
+class Print {
+  public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+	size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+	size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+	size_t print(const char *str) { return write(str); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(int value, int base = DEC) { return print((long)value, base); }
+	size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println() { return write("\r\n"); }
+	template<typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template<typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// Serial writes to stdout
+class HardwareSerial : public Print {
+  public:
+	void begin(unsigned long baud) { (void)baud; }
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// Milliseconds and microseconds since the program started
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+Prints rapid wind and Tempest observations on a Linux host using
+WeatherFlowAsync. Build from the top of the library, with
+ArduinoJson in ../ArduinoJson:
+
+  g++ -std=gnu++20 -Iextras/host -Isrc -I../ArduinoJson/src \
+    extras/host/AsyncPrinter.cpp extras/host/Arduino.cpp \
+    src/WeatherFlowAsync.cpp src/WeatherFlowData.cpp \
+    src/WeatherFlowDedupe.cpp src/WeatherFlowHeap.cpp \
+    src/WeatherFlowRain.cpp src/WeatherFlowRawPacket.cpp \
+    src/WeatherFlowSequence.cpp src/WeatherFlowStrings.cpp \
+    src/WeatherFlowWatchdog.cpp -o AsyncPrinter
+*/
+
+#include <Arduino.h>
+#include <WeatherFlowAsync.h>
+#include <WeatherFlowStrings.h>
+
+WeatherFlowAsync currentWeather;
+
+void printValue(WeatherFlowData::Key key) {
+  JsonVariantConst value = currentWeather.getValue(key);
+  if (value.isNull())
+    return;
+  Serial.print(WeatherFlowStrings::description_P(key));
+  Serial.print(F(": "));
+  if (value.is<const char*>())
+    Serial.print((const char*)value);
+  else if (value.is<int>())
+    Serial.print((int)value);
+  else
+    Serial.print((float)value);
+  Serial.print(F(" "));
+  Serial.println(WeatherFlowStrings::unit_P(key));
+}
+
+// Every rapid wind object, from any device
+WeatherFlowAsync::Task printWind() {
+  for (;;) {
+    bool arrived = co_await currentWeather.next(WeatherFlowData::WIND);
+    if (!arrived)
+      break;
+    printValue(WeatherFlowData::Serial_Number);
+    printValue(WeatherFlowData::Wind_Speed);
+    printValue(WeatherFlowData::Wind_Direction);
+  }
+}
+
+// Every Tempest observation, from any device
+WeatherFlowAsync::Task printObservations() {
+  for (;;) {
+    bool arrived = co_await currentWeather.next(WeatherFlowData::TEMPEST);
+    if (!arrived)
+      break;
+    printValue(WeatherFlowData::Serial_Number);
+    printValue(WeatherFlowData::Air_Temperature);
+    printValue(WeatherFlowData::Relative_Humidity);
+    printValue(WeatherFlowData::Station_Pressure);
+  }
+}
+
+int main() {
+  if (!currentWeather.begin())
+    return 1;
+
+  printWind();
+  printObservations();
+
+  // Handle packets until stop()
+  currentWeather.run();
+  return 0;
+}
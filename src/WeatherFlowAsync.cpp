@@ -0,0 +1,201 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowAsync.h"
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//#define DEBUG (0)
+
+// Events handled per call to epoll_wait
+#define MAX_EVENTS (4)
+
+WeatherFlowAsync::WeatherFlowAsync() :
+	socketFd(-1),
+	epollFd(-1),
+	running(false)
+	{
+}
+
+WeatherFlowAsync::~WeatherFlowAsync() {
+	stop();
+}
+
+bool WeatherFlowAsync::begin(uint16_t port) {
+	if (running)
+		return true;
+
+	socketFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (socketFd < 0)
+		return false;
+
+	// Other listeners on this host can share the broadcast port
+	int on = 1;
+	setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	setsockopt(socketFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(socketFd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+#ifdef DEBUG
+		Serial.println(F("Failed to bind WeatherFlow port"));
+#endif
+		close(socketFd);
+		socketFd = -1;
+		return false;
+	}
+
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = socketFd;
+	if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, socketFd, &event) < 0) {
+		stop();
+		return false;
+	}
+
+	running = true;
+	receive();
+	return true;
+}
+
+// Receive stage: wait until the socket is readable, then hand every
+// waiting datagram on to be decoded, stored and dispatched
+WeatherFlowAsync::Task WeatherFlowAsync::receive() {
+	char buffer[WEATHERFLOW_ASYNC_PACKET_SIZE];
+	while (running) {
+		co_await Readable{*this};
+
+		ssize_t length;
+		while ((length = recv(socketFd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+			// WeatherFlow sends JSON objects, relays send MessagePack
+			if (buffer[0] == '{') {
+				buffer[length] = '\0';
+				processPacket(buffer);
+			} else {
+				processPacket((const uint8_t*)buffer, length);
+			}
+		}
+	}
+}
+
+int WeatherFlowAsync::poll(int timeout) {
+	if (epollFd < 0)
+		return -1;
+
+	struct epoll_event events[MAX_EVENTS];
+	int count = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+	if (count < 0)
+		return errno == EINTR ? 0 : -1;
+
+	if (count > 0 && receiver) {
+		std::coroutine_handle<> handle = receiver;
+		receiver = nullptr;
+		handle.resume();
+	}
+
+	// Notice devices that have stopped reporting
+	checkHealth();
+	return count;
+}
+
+void WeatherFlowAsync::run() {
+	while (running && poll(WEATHERFLOW_ASYNC_HEALTH_INTERVAL) >= 0)
+		;
+}
+
+void WeatherFlowAsync::stop() {
+	running = false;
+
+	// The receive stage is waiting for the socket, so it can be
+	// destroyed there; if it is running it ends once the socket closes
+	if (receiver) {
+		std::coroutine_handle<> handle = receiver;
+		receiver = nullptr;
+		handle.destroy();
+	}
+	if (socketFd >= 0)
+		close(socketFd);
+	if (epollFd >= 0)
+		close(epollFd);
+	socketFd = -1;
+	epollFd = -1;
+
+	std::vector<NextObject*> cancelled;
+	cancelled.swap(waiters);
+	for (NextObject *waiter : cancelled) {
+		waiter->arrived = false;
+		waiter->handle.resume();
+	}
+}
+
+WeatherFlowAsync::NextObject WeatherFlowAsync::next(WeatherFlowData::Object obj, const char *serial) {
+	return NextObject(*this, obj, serial);
+}
+
+WeatherFlowAsync::NextObject::NextObject(WeatherFlowAsync &owner, WeatherFlowData::Object obj, const char *serial) :
+	owner(owner),
+	obj(obj),
+	arrived(false)
+	{
+	strncpy(this->serial, serial ? serial : "", WEATHERFLOW_SERIAL_LENGTH - 1);
+	this->serial[WEATHERFLOW_SERIAL_LENGTH - 1] = '\0';
+}
+
+void WeatherFlowAsync::NextObject::await_suspend(std::coroutine_handle<> handle) {
+	this->handle = handle;
+	owner.waiters.push_back(this);
+}
+
+// After the callback, resume the consumers waiting for this object.
+// They are taken off the list first, as they may wait again.
+void WeatherFlowAsync::dispatched(WeatherFlowData::Object obj, size_t row) {
+	if (waiters.empty())
+		return;
+
+	const char *serial = getValue(obj, Serial_Number);
+	std::vector<NextObject*> ready;
+	for (size_t i = 0; i < waiters.size();) {
+		NextObject *waiter = waiters[i];
+		if (waiter->obj == obj && (!waiter->serial[0] || (serial && strcmp(waiter->serial, serial) == 0))) {
+			ready.push_back(waiter);
+			waiters.erase(waiters.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	for (NextObject *waiter : ready) {
+		waiter->arrived = true;
+		waiter->handle.resume();
+	}
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowAsync_H
+#define _WeatherFlowAsync_H
+
+/***
+    Receives WeatherFlow packets on a Linux host with epoll and C++20
+    coroutines, instead of polling in a loop.
+
+    The receive stage is a coroutine that waits for the socket to be
+    readable, reads every waiting datagram and hands it to the
+    decode, store and dispatch stages of WeatherFlowData. Consumers
+    are coroutines too, and co_await the next object of a type,
+    optionally from one serial number:
+
+      WeatherFlowAsync::Task showWind(WeatherFlowAsync &weather) {
+        for (;;) {
+          bool arrived = co_await weather.next(WeatherFlowData::WIND, "ST-00000512");
+          if (!arrived)
+            break;
+          printf("%f\n", weather.getValue(WeatherFlowData::Wind_Speed).as<float>());
+        }
+      }
+
+    A waiting consumer is resumed from within dispatch, so getValue()
+    returns the row being dispatched, as it does in the callback.
+
+    run() waits for packets until stop(). To share an existing event
+    loop, add fd() to it and call poll(0) whenever it is readable.
+    Only built on Linux with a compiler that supports coroutines.
+    There is no Arduino core there, so build with extras/host on the
+    include path for its Arduino.h, and link extras/host/Arduino.cpp;
+    extras/host/AsyncPrinter.cpp is an example with the full command.
+ */
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+
+#include "Arduino.h"
+#include "WeatherFlowData.h"
+#include <coroutine>
+#include <vector>
+
+#ifndef WEATHERFLOW_UDP_PORT
+#define WEATHERFLOW_UDP_PORT (50222)
+#endif
+
+// Largest datagram read
+#define WEATHERFLOW_ASYNC_PACKET_SIZE (2048)
+// Milliseconds between health checks while no packets arrive
+#define WEATHERFLOW_ASYNC_HEALTH_INTERVAL (1000)
+
+class WeatherFlowAsync : public WeatherFlowData {
+  public:
+    WeatherFlowAsync();
+    ~WeatherFlowAsync();
+
+	/* A coroutine that starts at once and runs until it returns, e.g.
+	   a consumer of objects. Nothing waits for it to finish */
+	struct Task {
+		struct promise_type {
+			Task get_return_object() { return Task(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { abort(); }
+		};
+	};
+
+	/* Waits for the next object of a type. Resumes true when one is
+	   dispatched, false if stop() was called */
+	class NextObject {
+	  public:
+		NextObject(WeatherFlowAsync &owner, Object obj, const char *serial);
+		bool await_ready() const { return !owner.running; }
+		void await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const { return arrived; }
+
+	  private:
+		friend class WeatherFlowAsync;
+		WeatherFlowAsync &owner;
+		Object obj;
+		char serial[WEATHERFLOW_SERIAL_LENGTH];
+		std::coroutine_handle<> handle;
+		bool arrived;
+	};
+
+    /* Bind the port and start the receive stage. Returns false if
+       the socket could not be set up */
+    bool begin(uint16_t port = WEATHERFLOW_UDP_PORT);
+
+    /* Wait for the next object of type obj, from serial if it is
+       given. Use with co_await */
+    NextObject next(Object obj, const char *serial = 0);
+
+    /* Wait up to timeout milliseconds (-1 for ever) for packets and
+       process them. Returns the number of events handled, or -1 */
+    int poll(int timeout);
+
+    /* Process packets until stop() */
+    void run();
+
+    /* Close the socket, end the receive stage and resume every
+       waiting consumer with false */
+    void stop();
+
+    /* epoll descriptor to add to another event loop */
+    int fd() const { return epollFd; }
+
+  protected:
+	void dispatched(Object obj, size_t row) override;
+
+  private:
+	// Waits until the socket is readable
+	struct Readable {
+		WeatherFlowAsync &owner;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { owner.receiver = handle; }
+		void await_resume() const {}
+	};
+
+	Task receive();
+
+	int socketFd;
+	int epollFd;
+	bool running;
+	std::coroutine_handle<> receiver;
+	std::vector<NextObject*> waiters;
+};
+
+#endif
+#endif
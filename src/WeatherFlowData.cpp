@@ -23,6 +23,15 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 //#define DEBUG (0)
 
+// Seconds between device_status packets
+#define STATUS_INTERVAL (60)
+// Seconds between hub_status packets
+#define HUB_INTERVAL (10)
+// Seconds between rapid_wind packets
+#define WIND_INTERVAL (3)
+// Returned by processRawPacket when the packet could not be indexed
+#define NOT_INDEXED (-2)
+
 // Commonly used strings when parsing objects
 const char *WeatherFlowData::SERIAL_NUMBER = "serial_number";
 const char *WeatherFlowData::TYPE = "type";
@@ -36,28 +45,105 @@ const char *WeatherFlowData::UPTIME = "uptime";
 const char *WeatherFlowData::RSSI = "rssi";
 const char *WeatherFlowData::RADIO_STATS = "radio_stats";
 
+// Value of the type field for each Object
+const char *WeatherFlowData::OBJECT_TYPES[LAST_OBJECT] = {
+	"evt_precip",
+	"evt_strike",
+	"rapid_wind",
+	"obs_air",
+	"obs_sky",
+	"obs_st",
+	"device_status",
+	"hub_status"
+};
+
+const char *WeatherFlowData::RAIN_LAST_HOUR = "last_hour";
+const char *WeatherFlowData::RAIN_LAST_24_HOURS = "last_24_hours";
+const char *WeatherFlowData::RAIN_TODAY = "today";
+const char *WeatherFlowData::RAIN_RATE = "rate";
+const char *WeatherFlowData::RAIN_EVENT_START = "event_start";
+const char *WeatherFlowData::RAIN_EVENT_END = "event_end";
+const char *WeatherFlowData::RAIN_EVENT_TOTAL = "event_total";
+const char *WeatherFlowData::RAIN_MISSED_MINUTES = "missed_minutes";
+
 WeatherFlowData::WeatherFlowData() :
-	rainEventJsonDocument(0),
-	strikeEventJsonDocument(0),
-	windEventJsonDocument(0),
-	skyEventJsonDocument(0),
-	airEventJsonDocument(0),
-	tempestEventJsonDocument(0),
-	statusEventJsonDocument(0),
-	hubEventJsonDocument(0),
+	rainEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	strikeEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	windEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	skyEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	airEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	tempestEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	statusEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	hubEventJsonDocument(WEATHERFLOW_ALLOCATOR),
+	rawStaging(0),
+	incomingDocument(0),
+	incomingRaw(0),
+	rainUseCounter(0),
+	rainDayOffset(0),
 	eventCallback(0),
-	currentCallback(LAST_OBJECT)
+	currentCallback(LAST_OBJECT),
+	currentRow(0),
+	currentLate(false),
+	healthCallback(0),
+	healthContext(0)
 	{
+	for (int i = 0; i < LAST_OBJECT; i++) {
+		newestRows[i] = 0;
+		rawPackets[i] = 0;
+		rawStored[i] = false;
+		expectedIntervals[i] = 0;
+		staleObjects[i] = false;
+	}
+	for (int i = 0; i < WEATHERFLOW_RAIN_STATIONS; i++) {
+		rainStations[i].serial[0] = 0;
+		rainStations[i].lastUsed = 0;
+	}
+	watchdog.registerStale(deviceStale, this);
 }
 
 WeatherFlowData::~WeatherFlowData() {
+	setLazyDecoding(false);
+}
+
+// Keep packets as raw text and only convert the values that are read.
+// A slot for each type is allocated the first time that type arrives.
+bool WeatherFlowData::setLazyDecoding(bool enable) {
+	if (enable) {
+		if (!rawStaging)
+			rawStaging = new WeatherFlowRawPacket();
+		return rawStaging != 0;
+	}
+
+	// Keep the stored objects by converting them to documents
+	for (int objInt = RAIN; objInt != LAST_OBJECT; objInt++) {
+		if (rawStored[objInt]) {
+			deserializeJson(*objectDocument(static_cast<Object>(objInt)), rawPackets[objInt]->text(), rawPackets[objInt]->length());
+			rawStored[objInt] = false;
+		}
+		delete rawPackets[objInt];
+		rawPackets[objInt] = 0;
+	}
+	delete rawStaging;
+	rawStaging = 0;
+	return true;
+}
+
+bool WeatherFlowData::isLazyDecoding() {
+	return rawStaging != 0;
 }
 
 // Caller can free buffer on return as the data is copied
 int WeatherFlowData::processPacket(const char* buffer) {
-	// What sort of object is it
-	JsonDocument tempDoc;
+	WEATHERFLOW_HEAP_SITE(Process_Packet);
 	int bufferlen = strlen(buffer);
+	if (rawStaging) {
+		int result = processRawPacket(buffer, bufferlen);
+		if (result != NOT_INDEXED)
+			return result;
+	}
+	
+	// What sort of object is it
+	JsonDocument tempDoc{WEATHERFLOW_ALLOCATOR};
 	DeserializationError err = deserializeJson(tempDoc, buffer);
 	
 	if (err) {
@@ -73,6 +159,20 @@ int WeatherFlowData::processPacket(const char* buffer) {
 	}
 	return processJsonDocument(tempDoc);
 }
+
+// Caller can free buffer on return as the data is copied
+int WeatherFlowData::processPacket(const uint8_t* buffer, size_t length) {
+	WEATHERFLOW_HEAP_SITE(Process_Packet);
+	JsonDocument tempDoc{WEATHERFLOW_ALLOCATOR};
+	DeserializationError err = deserializeMsgPack(tempDoc, buffer, length);
+	
+	if (err) {
+		Serial.print(F("deserializeMsgPack() failed: "));
+		Serial.println(err.c_str());
+		return -1;
+	}
+	return processJsonDocument(tempDoc);
+}
 	
 int WeatherFlowData::processJsonDocument(JsonDocument & doc) {
 
@@ -81,47 +181,189 @@ int WeatherFlowData::processJsonDocument(JsonDocument & doc) {
 	Serial.println((const char*)doc[TYPE]);
 #endif
 	
-	if (strcmp("evt_precip", doc[TYPE]) == 0) {
-		// copy the document so that the passed in doc can be freed
-		rainEventJsonDocument = doc;
-		rainEventJsonDocument.shrinkToFit();
-		currentCallback = RAIN;
+	incomingDocument = &doc;
+	int result = processIncoming(objectForType(doc[TYPE]));
+	incomingDocument = 0;
+	return result;
+}
+
+// Index the packet text without converting it. Packets that will not
+// fit in a slot are left for the JSON parser.
+int WeatherFlowData::processRawPacket(const char *buffer, size_t length) {
+	if (!rawStaging->parse(buffer, length))
+		return NOT_INDEXED;
+	
+	Object obj = LAST_OBJECT;
+	for (int objInt = RAIN; objInt != LAST_OBJECT; objInt++) {
+		if (rawStaging->equals(TYPE, OBJECT_TYPES[objInt]))
+			obj = static_cast<Object>(objInt);
 	}
-	else if (strcmp("evt_strike", doc[TYPE]) == 0) {
-		strikeEventJsonDocument = doc;
-		strikeEventJsonDocument.shrinkToFit();
-		currentCallback = LIGHTNING;
+	
+	incomingRaw = rawStaging;
+	int result = processIncoming(obj);
+	incomingRaw = 0;
+	return result;
+}
+
+// Process the incoming packet, held in incomingDocument or incomingRaw
+int WeatherFlowData::processIncoming(WeatherFlowData::Object obj) {
+	if (obj == LAST_OBJECT) {
+#ifdef DEBUG
+		Serial.println(F("unknown message type"));
+#endif
+		return -1;
 	}
-	else if (strcmp("rapid_wind", doc[TYPE]) == 0) {
-		windEventJsonDocument = doc;
-		windEventJsonDocument.shrinkToFit();
-		currentCallback = WIND;
+	WEATHERFLOW_HEAP_OBJECT(obj);
+	
+	// Drop copies of a packet that has already been processed
+	if (isDuplicate(obj)) {
+#ifdef DEBUG
+		Serial.println(F("duplicate packet dropped"));
+#endif
+		return 1;
 	}
-	else if (strcmp("obs_air", doc[TYPE]) == 0) {
-		airEventJsonDocument = doc;
-		airEventJsonDocument.shrinkToFit();
-		currentCallback = AIR;
+	
+	// The device is still reporting
+	bool recovered = watchdog.seen(getPacketValue(obj, Serial_Number), obj, expectedInterval(obj), millis());
+	
+	// Observations can carry many rows, e.g. after the hub has been
+	// offline, so they are handled a row at a time
+	int result;
+	if (obj == AIR || obj == SKY || obj == TEMPEST)
+		result = processObservations(obj);
+	else
+		result = processEvent(obj);
+	
+	// Report the recovery once the new packet is available
+	if (recovered && healthCallback)
+		healthCallback(obj, getPacketValue(obj, Serial_Number), false, healthContext);
+	return result;
+}
+
+// Process a packet that holds a single event or status
+int WeatherFlowData::processEvent(WeatherFlowData::Object obj) {
+	// Only the newest packet from a device is stored
+	if (checkSequence(obj, 0) != WeatherFlowSequence::Accepted) {
+#ifdef DEBUG
+		Serial.println(F("out of order packet dropped"));
+#endif
+		return 2;
 	}
-	else if (strcmp("obs_sky", doc[TYPE]) == 0) {
-		skyEventJsonDocument = doc;
-		skyEventJsonDocument.shrinkToFit();
-		currentCallback = SKY;
+	
+	storePacket(obj);
+	if (obj == RAIN) {
+		RainStation *station = rainStation(getValue(RAIN, Serial_Number), true);
+		if (station) {
+			station->accumulator.startEvent(getValue(RAIN, Time_Epoch).as<uint32_t>());
+			updateRainTotals(*station);
+		}
 	}
-	else if (strcmp("obs_st", doc[TYPE]) == 0) {
-		tempestEventJsonDocument = doc;
-		tempestEventJsonDocument.shrinkToFit();
-		currentCallback = TEMPEST;
+	dispatch(obj, 0);
+	return 0;
+}
+
+// Walk the rows of an obs array oldest first. Rows newer than any
+// already seen from the device are stored and dispatched, one
+// callback per row. Late rows that fill a gap are dispatched only. Every row is offered to the rain totals, which
+// ignore minutes already counted, so late rows can fill gaps.
+int WeatherFlowData::processObservations(WeatherFlowData::Object obj) {
+	size_t count = packetRowCount(obj);
+	if (count == 0)
+		return -1;
+	
+	// One pass to find the newest row, and if the rows are in order
+	bool ascending = true;
+	size_t newest = 0;
+	uint32_t newestTime = 0;
+	for (size_t row = 0; row < count; row++) {
+		uint32_t time = getPacketValue(obj, Time_Epoch, row).as<uint32_t>();
+		if (row > 0 && time <= newestTime)
+			ascending = false;
+		if (row == 0 || time > newestTime) {
+			newest = row;
+			newestTime = time;
+		}
 	}
-	else if (strcmp("device_status", doc[TYPE]) == 0) {
-		statusEventJsonDocument = doc;
-		statusEventJsonDocument.shrinkToFit();
-		currentCallback = STATUS;
+	// Raw packets keep the values of the newest row once converted
+	if (incomingRaw)
+		incomingRaw->setCacheRow(newest);
+	
+	bool stored = false;
+	bool late = false;
+	uint32_t previousTime = 0;
+	for (size_t i = 0; i < count; i++) {
+		// Rows are normally in order, otherwise pick the next oldest
+		size_t row = i;
+		if (!ascending) {
+			bool found = false;
+			uint32_t nextTime = 0;
+			for (size_t r = 0; r < count; r++) {
+				uint32_t time = getPacketValue(obj, Time_Epoch, r).as<uint32_t>();
+				if (time > previousTime && (!found || time < nextTime)) {
+					row = r;
+					nextTime = time;
+					found = true;
+				}
+			}
+			if (!found)
+				break;
+		}
+		previousTime = getPacketValue(obj, Time_Epoch, row).as<uint32_t>();
+		
+		WeatherFlowSequence::Result order = checkSequence(obj, row);
+		if (obj == SKY || obj == TEMPEST)
+			accumulateRain(obj, row);
+		if (order == WeatherFlowSequence::Rejected) {
+#ifdef DEBUG
+			Serial.println(F("out of order observation dropped"));
+#endif
+			continue;
+		}
+		// A late row that fills a gap is passed on, read from the
+		// packet, but never replaces the newer stored row
+		if (order == WeatherFlowSequence::Reordered) {
+			currentLate = true;
+			dispatch(obj, row);
+			currentLate = false;
+			late = true;
+			continue;
+		}
+		
+		if (!stored) {
+			storePacket(obj);
+			newestRows[obj] = newest;
+			stored = true;
+		}
+		dispatch(obj, row);
 	}
-	else if (strcmp("hub_status", doc[TYPE]) == 0) {
-		hubEventJsonDocument = doc;
-		hubEventJsonDocument.shrinkToFit();
-		currentCallback = HUB;
+	return (stored || late) ? 0 : 2;
+}
+
+// Keep the incoming packet as the last object of its type
+void WeatherFlowData::storePacket(WeatherFlowData::Object obj) {
+	JsonDocument *stored = objectDocument(obj);
+	staleObjects[obj] = false;
+	if (incomingRaw) {
+		// The staging slot becomes the stored object, and the slot it
+		// replaces is reused for the next packet
+		rawStaging = rawPackets[obj];
+		rawPackets[obj] = incomingRaw;
+		rawStored[obj] = true;
+		stored->clear();
+		if (!rawStaging)
+			rawStaging = new WeatherFlowRawPacket();
+	} else {
+		// copy the document so that the passed in doc can be freed
+		*stored = *incomingDocument;
+		stored->shrinkToFit();
+		rawStored[obj] = false;
 	}
+}
+
+// Invoke the callback for one row of a stored object
+void WeatherFlowData::dispatch(WeatherFlowData::Object obj, size_t row) {
+	currentCallback = obj;
+	currentRow = row;
 
 #ifdef DEBUG
 	for (int objInt = WeatherFlowData::RAIN; objInt != WeatherFlowData::LAST_OBJECT; objInt++) {
@@ -131,21 +373,152 @@ int WeatherFlowData::processJsonDocument(JsonDocument & doc) {
 		}
 #endif
 
-	// Invoke callback if packet is identified
-	if (currentCallback != LAST_OBJECT) {
-		// call callback function
-		if (eventCallback) {
-			eventCallback(currentCallback, callbackContext);
+	// call callback function
+	if (eventCallback) {
+		eventCallback(currentCallback, callbackContext);
+	}
+	dispatched(obj, row);
+	currentCallback = LAST_OBJECT;
+	currentRow = 0;
+}
+
+WeatherFlowData::Object WeatherFlowData::objectForType(const char *type) {
+	if (type) {
+		for (int objInt = RAIN; objInt != LAST_OBJECT; objInt++) {
+			if (strcmp(OBJECT_TYPES[objInt], type) == 0)
+				return static_cast<Object>(objInt);
 		}
-		currentCallback = LAST_OBJECT;
-		return 0;
 	}
+	return LAST_OBJECT;
+}
 
-#ifdef DEBUG
-	Serial.print(F("unknown message type"));
-	Serial.println((const char*)doc[TYPE]);
-#endif
-	return -1;
+const char *WeatherFlowData::objectType(WeatherFlowData::Object obj) {
+	if (obj < LAST_OBJECT)
+		return OBJECT_TYPES[obj];
+	return "";
+}
+
+// A packet is identified by the device that sent it, its type and
+// its time. Hubs report every 10 seconds, so their sequence number
+// is added too. A flush of buffered observations can start with a
+// row already seen, so the row count and newest row time are added.
+bool WeatherFlowData::isDuplicate(WeatherFlowData::Object obj) {
+	uint32_t key = WeatherFlowDedupe::hash(getPacketValue(obj, Serial_Number).as<const char*>());
+	key = WeatherFlowDedupe::hash((uint32_t)obj, key);
+	key = WeatherFlowDedupe::hash(getPacketValue(obj, Time_Epoch).as<uint32_t>(), key);
+	if (obj == HUB)
+		key = WeatherFlowDedupe::hash(getPacketValue(obj, Sequence_Count).as<uint32_t>(), key);
+	if (obj == AIR || obj == SKY || obj == TEMPEST) {
+		size_t count = packetRowCount(obj);
+		uint32_t newestTime = 0;
+		for (size_t row = 1; row < count; row++) {
+			uint32_t time = getPacketValue(obj, Time_Epoch, row).as<uint32_t>();
+			if (time > newestTime)
+				newestTime = time;
+		}
+		key = WeatherFlowDedupe::hash((uint32_t)count, key);
+		key = WeatherFlowDedupe::hash(newestTime, key);
+	}
+	return dedupeCache.seen(key, millis());
+}
+
+uint32_t WeatherFlowData::duplicatePackets() {
+	return dedupeCache.duplicates();
+}
+
+// Place the packet in the stream from its device. Hubs number their
+// packets; observations are expected every Report_Interval minutes.
+WeatherFlowSequence::Result WeatherFlowData::checkSequence(WeatherFlowData::Object obj, size_t row) {
+	// Events are not periodic and every one is wanted, copies are
+	// already dropped by isDuplicate()
+	if (obj == RAIN || obj == LIGHTNING)
+		return WeatherFlowSequence::Accepted;
+	
+	const char *serial = getPacketValue(obj, Serial_Number);
+	uint32_t time = getPacketValue(obj, Time_Epoch, row).as<uint32_t>();
+	uint32_t interval = 0;
+	int32_t sequence = -1;
+	switch (obj) {
+		case AIR:
+		case SKY:
+		case TEMPEST:
+			interval = getPacketValue(obj, Report_Interval, row).as<uint32_t>() * 60;
+			break;
+		case STATUS:
+			interval = STATUS_INTERVAL;
+			break;
+		case HUB:
+			sequence = getPacketValue(obj, Sequence_Count).as<int32_t>();
+			break;
+	}
+	return sequenceTracker.check(serial, obj, time, interval, sequence);
+}
+
+int WeatherFlowData::deviceCount() {
+	return sequenceTracker.count();
+}
+
+const WeatherFlowSequence::Device& WeatherFlowData::deviceStats(int index) {
+	return sequenceTracker.device(index);
+}
+
+// Expected seconds between packets of type obj. Events are not
+// periodic, so they never go stale.
+uint32_t WeatherFlowData::expectedInterval(WeatherFlowData::Object obj) {
+	if (expectedIntervals[obj])
+		return expectedIntervals[obj];
+	switch (obj) {
+		case WIND:
+			return WIND_INTERVAL;
+		case AIR:
+		case SKY:
+		case TEMPEST:
+			return getPacketValue(obj, Report_Interval).as<uint32_t>() * 60;
+		case STATUS:
+			return STATUS_INTERVAL;
+		case HUB:
+			return HUB_INTERVAL;
+	}
+	return 0;
+}
+
+void WeatherFlowData::setExpectedInterval(WeatherFlowData::Object obj, uint32_t seconds) {
+	if (obj < LAST_OBJECT)
+		expectedIntervals[obj] = seconds;
+}
+
+void WeatherFlowData::registerHealthCallback(WeatherFlowData::EHealthFunction callback, void* context) {
+	healthCallback = callback;
+	healthContext = context;
+}
+
+void WeatherFlowData::checkHealth() {
+	watchdog.advance(millis());
+}
+
+bool WeatherFlowData::isStale(WeatherFlowData::Object obj) {
+	return obj < LAST_OBJECT && staleObjects[obj];
+}
+
+int WeatherFlowData::healthCount() {
+	return watchdog.count();
+}
+
+const WeatherFlowWatchdog::Device& WeatherFlowData::deviceHealth(int index) {
+	return watchdog.device(index);
+}
+
+// Called by the watchdog when a device stops reporting. If the
+// stored object came from that device it is stale too.
+void WeatherFlowData::deviceStale(const WeatherFlowWatchdog::Device& device, void* context) {
+	WeatherFlowData *data = (WeatherFlowData*)context;
+	Object obj = static_cast<Object>(device.type);
+	const char *serial = data->getValue(obj, Serial_Number, 0);
+	if (serial && strncmp(serial, device.serial, WEATHERFLOW_SERIAL_LENGTH - 1) == 0)
+		data->staleObjects[obj] = true;
+	
+	if (data->healthCallback)
+		data->healthCallback(obj, device.serial, true, data->healthContext);
 }
 
 JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Key key) {
@@ -153,16 +526,108 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Key key) {
 }
 
 JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherFlowData::Key key) {
+	// Within a callback use the row being dispatched, otherwise the newest
+	if (obj == currentCallback && currentLate)
+		return getPacketValue(obj, key, currentRow);
+	if (obj == currentCallback)
+		return getValue(obj, key, currentRow);
+	if (obj < LAST_OBJECT)
+		return getValue(obj, key, newestRows[obj]);
+	return getValue(obj, key, 0);
+}
+
+JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherFlowData::Key key, size_t row) {
+	if (isStale(obj)) {
+		JsonObject empty;
+		return empty;
+	}
+	if (obj < LAST_OBJECT && rawStored[obj])
+		return getRawValue(obj, *rawPackets[obj], key, row);
+	return getDocumentValue(obj, storedDocument(obj), key, row);
+}
+
+size_t WeatherFlowData::rowCount(WeatherFlowData::Object obj) {
+	if (isStale(obj))
+		return 0;
+	switch (obj) {
+		case AIR:
+		case SKY:
+		case TEMPEST:
+			if (rawStored[obj])
+				return rawPackets[obj]->arraySize(OBS);
+			return storedDocument(obj)[OBS].size();
+	}
+	return hasObject(obj) ? 1 : 0;
+}
+
+// Value of key in the packet being processed
+JsonVariantConst WeatherFlowData::getPacketValue(WeatherFlowData::Object obj, WeatherFlowData::Key key, size_t row) {
+	if (incomingRaw)
+		return getRawValue(obj, *incomingRaw, key, row);
+	if (incomingDocument)
+		return getDocumentValue(obj, *incomingDocument, key, row);
+  JsonObject empty;
+  return empty;
+}
+
+size_t WeatherFlowData::packetRowCount(WeatherFlowData::Object obj) {
+	if (incomingRaw)
+		return incomingRaw->arraySize(OBS);
+	if (incomingDocument)
+		return (*incomingDocument)[OBS].size();
+	return 0;
+}
+
+// Convert the value of key from the packet text, or return the value
+// converted earlier. Obs values are kept by row and key.
+JsonVariantConst WeatherFlowData::getRawValue(WeatherFlowData::Object obj, WeatherFlowRawPacket& raw, WeatherFlowData::Key key, size_t row) {
+	if (isRainTotal(obj, key))
+		return getRainTotal(getRawValue(obj, raw, Serial_Number, row), key);
+	
+	ValuePath path = valuePath(obj, key, row);
+	if (path.member)
+		return raw.get(path.member, path.index1, path.index2, key, path.member == OBS ? (int)row : -1);
+  JsonObject empty;
+  return empty;
+}
+
+// Find the value of key in doc, which holds an object of type obj.
+// Used for both the stored objects and packets still being processed.
+// row selects the row of an obs array, other objects only have one.
+JsonVariantConst WeatherFlowData::getDocumentValue(WeatherFlowData::Object obj, JsonVariantConst doc, WeatherFlowData::Key key, size_t row) {
+	if (isRainTotal(obj, key))
+		return getRainTotal(getDocumentValue(obj, doc, Serial_Number, row), key);
+	
+	ValuePath path = valuePath(obj, key, row);
+	if (path.member) {
+		JsonVariantConst value = doc[path.member];
+		if (path.index1 >= 0)
+			value = value[path.index1];
+		if (path.index2 >= 0)
+			value = value[path.index2];
+		return value;
+	}
+  JsonObject empty;
+  return empty;
+}
+
+// Rain totals are kept by the library rather than read from a packet
+bool WeatherFlowData::isRainTotal(WeatherFlowData::Object obj, WeatherFlowData::Key key) {
+	return (obj == SKY || obj == TEMPEST) && key >= Rain_Last_Hour && key <= Rain_Missed_Minutes;
+}
+
+// Where key is found in an object of type obj
+WeatherFlowData::ValuePath WeatherFlowData::valuePath(WeatherFlowData::Object obj, WeatherFlowData::Key key, size_t row) {
 	switch (obj) {
 		case RAIN:
 		{
 			switch (key) {
 				case Serial_Number:
-					return rainEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return rainEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Time_Epoch:
-					return rainEventJsonDocument[EVT][0];
+					return ValuePath(EVT, 0);
 			}
 			break;
 		}
@@ -170,15 +635,15 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return strikeEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return strikeEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Time_Epoch:
-					return strikeEventJsonDocument[EVT][0];
+					return ValuePath(EVT, 0);
 				case Strike_Distance:
-					return strikeEventJsonDocument[EVT][1];
+					return ValuePath(EVT, 1);
 				case Energy:
-					return strikeEventJsonDocument[EVT][2];
+					return ValuePath(EVT, 2);
 			}
 			break;
 		}
@@ -186,15 +651,15 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return windEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return windEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Time_Epoch:
-					return windEventJsonDocument[OB][0];
+					return ValuePath(OB, 0);
 				case Wind_Speed:
-					return windEventJsonDocument[OB][1];
+					return ValuePath(OB, 1);
 				case Wind_Direction:
-					return windEventJsonDocument[OB][2];
+					return ValuePath(OB, 2);
 			}
 			break;
 		}
@@ -202,27 +667,27 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return airEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return airEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Firmware:
-					return airEventJsonDocument[FIRMWARE_REVISION];
+					return ValuePath(FIRMWARE_REVISION);
 				case Time_Epoch:
-					return airEventJsonDocument[OBS][0][0];
+					return ValuePath(OBS, row, 0);
 				case Station_Pressure:
-					return airEventJsonDocument[OBS][0][1];
+					return ValuePath(OBS, row, 1);
 				case Air_Temperature:
-					return airEventJsonDocument[OBS][0][2];
+					return ValuePath(OBS, row, 2);
 				case Relative_Humidity:
-					return airEventJsonDocument[OBS][0][3];
+					return ValuePath(OBS, row, 3);
 				case Strike_Count:
-					return airEventJsonDocument[OBS][0][4];
+					return ValuePath(OBS, row, 4);
 				case Strike_Avg_Distance:
-					return airEventJsonDocument[OBS][0][5];
+					return ValuePath(OBS, row, 5);
 				case Battery:
-					return airEventJsonDocument[OBS][0][6];
+					return ValuePath(OBS, row, 6);
 				case Report_Interval:
-					return airEventJsonDocument[OBS][0][7];
+					return ValuePath(OBS, row, 7);
 			}
 			break;
 		}
@@ -230,37 +695,37 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return skyEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return skyEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Firmware:
-					return skyEventJsonDocument[FIRMWARE_REVISION];
+					return ValuePath(FIRMWARE_REVISION);
 				case Time_Epoch:
-					return skyEventJsonDocument[OBS][0][0];
+					return ValuePath(OBS, row, 0);
 				case Illuminance:
-					return skyEventJsonDocument[OBS][0][1];
+					return ValuePath(OBS, row, 1);
 				case UV:
-					return skyEventJsonDocument[OBS][0][2];
+					return ValuePath(OBS, row, 2);
 				case Rain_Last_Minute:
-					return skyEventJsonDocument[OBS][0][3];
+					return ValuePath(OBS, row, 3);
 				case Wind_Lull:
-					return skyEventJsonDocument[OBS][0][4];
+					return ValuePath(OBS, row, 4);
 				case Wind_Avg:
-					return skyEventJsonDocument[OBS][0][5];
+					return ValuePath(OBS, row, 5);
 				case Wind_Gust:
-					return skyEventJsonDocument[OBS][0][6];
+					return ValuePath(OBS, row, 6);
 				case Wind_Direction:
-					return skyEventJsonDocument[OBS][0][7];
+					return ValuePath(OBS, row, 7);
 				case Battery:
-					return skyEventJsonDocument[OBS][0][8];
+					return ValuePath(OBS, row, 8);
 				case Report_Interval:
-					return skyEventJsonDocument[OBS][0][9];
+					return ValuePath(OBS, row, 9);
 				case Solar_Radiation:
-					return skyEventJsonDocument[OBS][0][10];
+					return ValuePath(OBS, row, 10);
 				case PrecipitationType:
-					return skyEventJsonDocument[OBS][0][12];
+					return ValuePath(OBS, row, 12);
 				case Wind_Sample_Interval:
-					return skyEventJsonDocument[OBS][0][13];
+					return ValuePath(OBS, row, 13);
 			}
 			break;
 		}
@@ -268,47 +733,47 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return tempestEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return tempestEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Firmware:
-					return tempestEventJsonDocument[FIRMWARE_REVISION];
+					return ValuePath(FIRMWARE_REVISION);
 				case Time_Epoch:
-					return tempestEventJsonDocument[OBS][0][0];
+					return ValuePath(OBS, row, 0);
 				case Wind_Lull:
-					return tempestEventJsonDocument[OBS][0][1];
+					return ValuePath(OBS, row, 1);
 				case Wind_Avg:
-					return tempestEventJsonDocument[OBS][0][2];
+					return ValuePath(OBS, row, 2);
 				case Wind_Gust:
-					return tempestEventJsonDocument[OBS][0][3];
+					return ValuePath(OBS, row, 3);
 				case Wind_Direction:
-					return tempestEventJsonDocument[OBS][0][4];
+					return ValuePath(OBS, row, 4);
 				case Wind_Sample_Interval:
-					return tempestEventJsonDocument[OBS][0][5];
+					return ValuePath(OBS, row, 5);
 				case Station_Pressure:
-					return tempestEventJsonDocument[OBS][0][6];
+					return ValuePath(OBS, row, 6);
 				case Air_Temperature:
-					return tempestEventJsonDocument[OBS][0][7];
+					return ValuePath(OBS, row, 7);
 				case Relative_Humidity:
-					return tempestEventJsonDocument[OBS][0][8];
+					return ValuePath(OBS, row, 8);
 				case Illuminance:
-					return tempestEventJsonDocument[OBS][0][9];
+					return ValuePath(OBS, row, 9);
 				case UV:
-					return tempestEventJsonDocument[OBS][0][10];
+					return ValuePath(OBS, row, 10);
 				case Solar_Radiation:
-					return tempestEventJsonDocument[OBS][0][11];
+					return ValuePath(OBS, row, 11);
 				case Rain_Last_Minute:
-					return tempestEventJsonDocument[OBS][0][12];
+					return ValuePath(OBS, row, 12);
 				case PrecipitationType:
-					return tempestEventJsonDocument[OBS][0][13];
+					return ValuePath(OBS, row, 13);
 				case Strike_Avg_Distance:
-					return tempestEventJsonDocument[OBS][0][14];
+					return ValuePath(OBS, row, 14);
 				case Strike_Count:
-					return tempestEventJsonDocument[OBS][0][15];
+					return ValuePath(OBS, row, 15);
 				case Battery:
-					return tempestEventJsonDocument[OBS][0][16];
+					return ValuePath(OBS, row, 16);
 				case Report_Interval:
-					return tempestEventJsonDocument[OBS][0][17];
+					return ValuePath(OBS, row, 17);
 			}
 			break;
 		}
@@ -316,25 +781,25 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 		{
 			switch (key) {
 				case Serial_Number:
-					return statusEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Hub_Serial_Number:
-					return statusEventJsonDocument[HUB_SERIAL_NUMBER];
+					return ValuePath(HUB_SERIAL_NUMBER);
 				case Firmware:
-					return statusEventJsonDocument[FIRMWARE_REVISION];
+					return ValuePath(FIRMWARE_REVISION);
 				case Time_Epoch:
-					return statusEventJsonDocument[TIMESTAMP];
+					return ValuePath(TIMESTAMP);
 				case Uptime:
-					return statusEventJsonDocument[UPTIME];
+					return ValuePath(UPTIME);
 				case Battery:
-					return statusEventJsonDocument["voltage"];
+					return ValuePath("voltage");
 				case Rssi:
-					return statusEventJsonDocument[RSSI];
+					return ValuePath(RSSI);
 				case Hub_RSSI:
-					return statusEventJsonDocument["hub_rssi"];
+					return ValuePath("hub_rssi");
 				case Sensor_Status:
-					return statusEventJsonDocument["sensor_status"];
+					return ValuePath("sensor_status");
 				case Debug:
-					return statusEventJsonDocument["debug"];
+					return ValuePath("debug");
 			}
 			break;
 		}
@@ -343,29 +808,29 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 			switch (key) {
 				case Serial_Number:
 				case Hub_Serial_Number:
-					return hubEventJsonDocument[SERIAL_NUMBER];
+					return ValuePath(SERIAL_NUMBER);
 				case Firmware:
-					return hubEventJsonDocument[FIRMWARE_REVISION];
+					return ValuePath(FIRMWARE_REVISION);
 				case Time_Epoch:
-					return hubEventJsonDocument[TIMESTAMP];
+					return ValuePath(TIMESTAMP);
 				case Uptime:
-					return hubEventJsonDocument[UPTIME];
+					return ValuePath(UPTIME);
 				case Rssi:
-					return hubEventJsonDocument[RSSI];
+					return ValuePath(RSSI);
 				case Reset_Flags:
-					return hubEventJsonDocument["reset_flags"];
+					return ValuePath("reset_flags");
 				case Sequence_Count:
-					return hubEventJsonDocument["seq"];
+					return ValuePath("seq");
 				case Radio_Stats_Version:
-					return hubEventJsonDocument[RADIO_STATS][0];
+					return ValuePath(RADIO_STATS, 0);
 				case Radio_Stats_Reboot_Count:
-					return hubEventJsonDocument[RADIO_STATS][1];
+					return ValuePath(RADIO_STATS, 1);
 				case Radio_Stats_Bus_Error_Count:
-					return hubEventJsonDocument[RADIO_STATS][2];
+					return ValuePath(RADIO_STATS, 2);
 				case Radio_Stats_Status:
-					return hubEventJsonDocument[RADIO_STATS][3];
+					return ValuePath(RADIO_STATS, 3);
 				case Radio_Stats_Network_Id:
-					return hubEventJsonDocument[RADIO_STATS][4];
+					return ValuePath(RADIO_STATS, 4);
 			}
 			break;
 		}
@@ -377,11 +842,143 @@ JsonVariantConst WeatherFlowData::getValue(WeatherFlowData::Object obj, WeatherF
 			break;
 		}
 	}
+  return ValuePath();
+}
+
+// Find the rain totals kept for serial. With add set a station not
+// seen before takes the place of the least recently used one.
+WeatherFlowData::RainStation *WeatherFlowData::rainStation(const char *serial, bool add) {
+	if (!serial || !serial[0])
+		return 0;
+	
+	RainStation *oldest = &rainStations[0];
+	for (int i = 0; i < WEATHERFLOW_RAIN_STATIONS; i++) {
+		RainStation &station = rainStations[i];
+		if (station.serial[0] && strncmp(station.serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1) == 0) {
+			if (add)
+				station.lastUsed = ++rainUseCounter;
+			return &station;
+		}
+		if (station.lastUsed < oldest->lastUsed)
+			oldest = &station;
+	}
+	if (!add)
+		return 0;
+	
+	strncpy(oldest->serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1);
+	oldest->serial[WEATHERFLOW_SERIAL_LENGTH - 1] = 0;
+	oldest->lastUsed = ++rainUseCounter;
+	oldest->accumulator.reset();
+	oldest->accumulator.setDayOffset(rainDayOffset);
+	oldest->totals.clear();
+	return oldest;
+}
+
+JsonVariantConst WeatherFlowData::getRainTotal(const char *serial, WeatherFlowData::Key key) {
+	RainStation *station = rainStation(serial, false);
+	if (station) {
+		JsonDocument &totals = station->totals;
+		switch (key) {
+			case Rain_Last_Hour:
+				return totals[RAIN_LAST_HOUR];
+			case Rain_Last_24_Hours:
+				return totals[RAIN_LAST_24_HOURS];
+			case Rain_Today:
+				return totals[RAIN_TODAY];
+			case Rain_Rate:
+				return totals[RAIN_RATE];
+			case Rain_Event_Start:
+				return totals[RAIN_EVENT_START];
+			case Rain_Event_End:
+				return totals[RAIN_EVENT_END];
+			case Rain_Event_Total:
+				return totals[RAIN_EVENT_TOTAL];
+			case Rain_Missed_Minutes:
+				return totals[RAIN_MISSED_MINUTES];
+		}
+	}
   JsonObject empty;
   return empty;
 }
 
+// Feed the rain amount of an observation into the running totals of
+// the station that sent it. Repeated minutes are ignored by the accumulator.
+void WeatherFlowData::accumulateRain(WeatherFlowData::Object obj, size_t row) {
+	JsonVariantConst amount = getPacketValue(obj, Rain_Last_Minute, row);
+	if (amount.isNull())
+		return;
+	RainStation *station = rainStation(getPacketValue(obj, Serial_Number, row), true);
+	if (station && station->accumulator.addMinute(getPacketValue(obj, Time_Epoch, row).as<uint32_t>(), amount.as<float>()))
+		updateRainTotals(*station);
+}
+
+void WeatherFlowData::updateRainTotals(RainStation &station) {
+	WeatherFlowRain &rain = station.accumulator;
+	JsonDocument &totals = station.totals;
+	totals[RAIN_LAST_HOUR] = rain.lastHour();
+	totals[RAIN_LAST_24_HOURS] = rain.last24Hours();
+	totals[RAIN_TODAY] = rain.today();
+	totals[RAIN_RATE] = rain.rate();
+	totals[RAIN_EVENT_TOTAL] = rain.eventTotal();
+	totals[RAIN_MISSED_MINUTES] = rain.missedMinutes();
+	
+	// Event boundaries are left null until they are known
+	if (rain.eventStart())
+		totals[RAIN_EVENT_START] = rain.eventStart();
+	else
+		totals[RAIN_EVENT_START] = nullptr;
+	if (rain.eventEnd())
+		totals[RAIN_EVENT_END] = rain.eventEnd();
+	else
+		totals[RAIN_EVENT_END] = nullptr;
+}
+
+void WeatherFlowData::setRainDayOffset(int32_t seconds) {
+	rainDayOffset = seconds;
+	for (int i = 0; i < WEATHERFLOW_RAIN_STATIONS; i++) {
+		if (!rainStations[i].serial[0])
+			continue;
+		rainStations[i].accumulator.setDayOffset(seconds);
+		if (!rainStations[i].totals.isNull())
+			updateRainTotals(rainStations[i]);
+	}
+}
+
+JsonVariantConst WeatherFlowData::storedDocument(WeatherFlowData::Object obj) {
+	JsonDocument *doc = objectDocument(obj);
+	if (doc)
+		return *doc;
+  JsonObject empty;
+  return empty;
+}
+
+JsonDocument *WeatherFlowData::objectDocument(WeatherFlowData::Object obj) {
+	switch (obj) {
+		case RAIN:
+			return &rainEventJsonDocument;
+		case LIGHTNING:
+			return &strikeEventJsonDocument;
+		case WIND:
+			return &windEventJsonDocument;
+		case AIR:
+			return &airEventJsonDocument;
+		case SKY:
+			return &skyEventJsonDocument;
+		case TEMPEST:
+			return &tempestEventJsonDocument;
+		case STATUS:
+			return &statusEventJsonDocument;
+		case HUB:
+			return &hubEventJsonDocument;
+	}
+	return 0;
+}
+
 bool WeatherFlowData::hasObject(WeatherFlowData::Object obj) {
+	if (isStale(obj))
+		return false;
+	if (obj < LAST_OBJECT && rawStored[obj])
+		return true;
 	switch (obj) {
 		case RAIN:
 			return rainEventJsonDocument.isNull() ? false : true;
@@ -404,6 +1001,13 @@ bool WeatherFlowData::hasObject(WeatherFlowData::Object obj) {
 }
 
 JsonDocument WeatherFlowData::lastObject(WeatherFlowData::Object obj) {
+	WEATHERFLOW_HEAP_SITE(Last_Object);
+	WEATHERFLOW_HEAP_OBJECT(obj);
+	if (obj < LAST_OBJECT && rawStored[obj]) {
+		JsonDocument copy{WEATHERFLOW_ALLOCATOR};
+		deserializeJson(copy, rawPackets[obj]->text(), rawPackets[obj]->length());
+		return copy;
+	}
 	switch (obj) {
 		case RAIN:
 			return rainEventJsonDocument;
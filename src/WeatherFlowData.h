@@ -25,6 +25,12 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "Arduino.h"
 #include "ArduinoJson.h"
+#include "WeatherFlowDedupe.h"
+#include "WeatherFlowHeap.h"
+#include "WeatherFlowRain.h"
+#include "WeatherFlowRawPacket.h"
+#include "WeatherFlowSequence.h"
+#include "WeatherFlowWatchdog.h"
 
 /***
 	Class to process WeatherFlow objects. Allows clients to register callbacks 
@@ -37,11 +43,25 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 class WeatherFlowData {
   public:
     WeatherFlowData();
-    ~WeatherFlowData();
+    virtual ~WeatherFlowData();
     
-    /* Handle a new JSON formated Weatherflow object */
+    /* Handle a new JSON formated Weatherflow object. Returns 0 when
+       processed, 1 when dropped as a duplicate, 2 when dropped because
+       a newer packet from the device has been processed, -1 on error */
     int processPacket(const char *packet);
     
+    /* Handle a WeatherFlow object encoded as MessagePack, as sent by
+       a WeatherFlowUdp relay. Returns the same values as above */
+    int processPacket(const uint8_t *packet, size_t length);
+    
+    /* Keep JSON packets handed to processPacket as raw text, indexed
+       but not parsed, and convert values only when getValue() asks
+       for them. Uses a fixed WEATHERFLOW_RAW_PACKET_SIZE buffer per
+       object type; larger packets are parsed as before. Returns
+       false if the memory could not be allocated */
+    bool setLazyDecoding(bool enable);
+    bool isLazyDecoding();
+    
     /* Known types of WeatherFlow objects */
 	enum Object {
 		RAIN,
@@ -98,6 +118,16 @@ class WeatherFlowData {
 		Radio_Stats_Status,
 		Radio_Stats_Network_Id,
 		
+		// Accumulated from Rain_Last_Minute of SKY and TEMPEST observations
+		Rain_Last_Hour,
+		Rain_Last_24_Hours,
+		Rain_Today,
+		Rain_Rate,
+		Rain_Event_Start,
+		Rain_Event_End,
+		Rain_Event_Total,
+		Rain_Missed_Minutes,
+		
 		Last_Value
 	};
 	
@@ -109,14 +139,40 @@ class WeatherFlowData {
 		Precipitation_Rain_Hail = 3
 	};
 	
+	// Value of the type field of packets holding this object,
+	// e.g. "obs_st"
+	static const char *objectType(Object obj);
+	
 	// Convenience method to use within a callback to get a
 	// specified value for key
 	JsonVariantConst getValue(Key val);
 	
-	// get a specific value for key from a specific object
+	// get a specific value for key from a specific object. For
+	// observations this is the newest row, or the row being
+	// dispatched when called from within a callback.
+	//
+	// Observation rows that arrive late but fill a gap, e.g. rows a
+	// hub flushes after a newer live packet, are dispatched too, so
+	// the callback can see a row older than the stored one. The
+	// stored object is not replaced; these two getValue() read the
+	// late row, while rowCount() and the row getValue() below still
+	// refer to the stored object.
 	JsonVariantConst getValue(Object obj, Key val);
 	
-	// Return true if this type of object has ever been processed
+	// get a value from a specific row of an observation. Hubs can
+	// send many rows at once, e.g. after being offline
+	//
+	// Values returned by getValue() refer to the stored object, with
+	// or without lazy decoding, and stay valid until the next packet
+	// of the same object type is stored, or only until the callback
+	// returns for a late row. Copy them to keep them longer.
+	JsonVariantConst getValue(Object obj, Key val, size_t row);
+	
+	// Number of rows in the last processed object of given type
+	size_t rowCount(Object obj);
+	
+	// Return true if this type of object has been processed and the
+	// device that sent it has not stopped reporting
 	bool hasObject(Object obj);
 	
 	// Return a COPY of the last processed object of given type
@@ -126,13 +182,97 @@ class WeatherFlowData {
 	//    void callback(void* context)
 	// Where the context passed to callback is the same as the
 	// context value provided during registration.
+	// An observation with several rows invokes the callback once
+	// for each new row, oldest first.
 	typedef std::function<void(Object obj, void* context)> ENotifierFunction;
 	void registerCallback(ENotifierFunction callback, void* context = 0);
 	
+	// Number of packets dropped because they had already been
+	// processed, e.g. heard by more than one hub
+	uint32_t duplicatePackets();
+	
+	// Packet statistics (received, lost, late) for each device and
+	// object type that has been seen, 0 <= index < deviceCount()
+	int deviceCount();
+	const WeatherFlowSequence::Device& deviceStats(int index);
+	
+	// Offset from UTC, in seconds, of the station's local time. Used
+	// to decide when Rain_Today restarts.
+	void setRainDayOffset(int32_t seconds);
+	
+	// A device is stale when it has missed WEATHERFLOW_STALE_INTERVALS
+	// of its expected packets. The health callback is called when a
+	// device goes stale, and again when it reports once more:
+	//    void callback(Object obj, const char *serial, bool stale, void* context)
+	// While the device that sent the last object of a type is stale,
+	// hasObject() is false and getValue() returns null for it.
+	typedef std::function<void(Object obj, const char *serial, bool stale, void* context)> EHealthFunction;
+	void registerHealthCallback(EHealthFunction callback, void* context = 0);
+	
+	// Expected seconds between packets of type obj. By default this
+	// is Report_Interval for observations, 3 for rapid wind, 60 for
+	// device status and 10 for hub status; events are never stale.
+	// 0 restores the default.
+	void setExpectedInterval(Object obj, uint32_t seconds);
+	
+	// Notice devices that have stopped reporting. Call regularly,
+	// WeatherFlowUdp::update() does so.
+	void checkHealth();
+	
+	// True if the device that sent the last object of this type has
+	// stopped reporting
+	bool isStale(Object obj);
+	
+	// Health of each device and object type that has been seen,
+	// 0 <= index < healthCount()
+	int healthCount();
+	const WeatherFlowWatchdog::Device& deviceHealth(int index);
+	
   protected:
 	int processJsonDocument(JsonDocument& doc);
+	int processRawPacket(const char *buffer, size_t length);
+	int processIncoming(Object obj);
+	int processObservations(Object obj);
+	int processEvent(Object obj);
+	void storePacket(Object obj);
+	// Store is done, call the callback for one row
+	void dispatch(Object obj, size_t row);
+	// Called by dispatch() after the callback, while getValue() still
+	// returns the row being dispatched. Subclasses can extend this to
+	// notify others
+	virtual void dispatched(Object obj, size_t row) {}
 	
   private:
+	static Object objectForType(const char *type);
+	JsonVariantConst storedDocument(Object obj);
+	JsonDocument *objectDocument(Object obj);
+	JsonVariantConst getPacketValue(Object obj, Key key, size_t row = 0);
+	size_t packetRowCount(Object obj);
+	JsonVariantConst getRawValue(Object obj, WeatherFlowRawPacket& raw, Key key, size_t row);
+	JsonVariantConst getDocumentValue(Object obj, JsonVariantConst doc, Key key, size_t row = 0);
+	static bool isRainTotal(Object obj, Key key);
+	
+	// Location of a value within an object: a member, then up to
+	// two array indexes, -1 if not used
+	struct ValuePath {
+		ValuePath(const char *member = 0, int index1 = -1, int index2 = -1) :
+			member(member), index1(index1), index2(index2) {}
+		const char *member;
+		int index1;
+		int index2;
+	};
+	static ValuePath valuePath(Object obj, Key key, size_t row);
+	bool isDuplicate(Object obj);
+	WeatherFlowSequence::Result checkSequence(Object obj, size_t row);
+	JsonVariantConst getRainTotal(const char *serial, Key key);
+	void accumulateRain(Object obj, size_t row);
+	uint32_t expectedInterval(Object obj);
+	static void deviceStale(const WeatherFlowWatchdog::Device& device, void* context);
+	struct RainStation;
+	RainStation *rainStation(const char *serial, bool add);
+	void updateRainTotals(RainStation &station);
+	
+
 	// Local copies of the last objects
 	JsonDocument rainEventJsonDocument;
 	JsonDocument strikeEventJsonDocument;
@@ -143,11 +283,53 @@ class WeatherFlowData {
 	JsonDocument statusEventJsonDocument;
 	JsonDocument hubEventJsonDocument;
 
+	// Objects kept as raw text when lazy decoding is enabled, and the
+	// slot the next packet is read into
+	WeatherFlowRawPacket *rawPackets[LAST_OBJECT];
+	WeatherFlowRawPacket *rawStaging;
+	bool rawStored[LAST_OBJECT];
+	
+	// The packet being processed
+	JsonDocument *incomingDocument;
+	WeatherFlowRawPacket *incomingRaw;
+
+	// Running precipitation totals for each station, and a copy of
+	// them to hand out. The least recently used station is dropped
+	// when more than WEATHERFLOW_RAIN_STATIONS report rain.
+	struct RainStation {
+		char serial[WEATHERFLOW_SERIAL_LENGTH];
+		uint32_t lastUsed;
+		WeatherFlowRain accumulator;
+		JsonDocument totals;
+	};
+	RainStation rainStations[WEATHERFLOW_RAIN_STATIONS];
+	uint32_t rainUseCounter;
+	int32_t rainDayOffset;
+
+	// Recently processed packets
+	WeatherFlowDedupe dedupeCache;
+	
+	// Order of packets from each device
+	WeatherFlowSequence sequenceTracker;
+
 	ENotifierFunction eventCallback;
 	void* callbackContext;
 	Object currentCallback;
+	size_t currentRow;
+	bool currentLate;	// currentRow is from a packet that is not stored
+	
+	// Row of each stored object holding the newest observation
+	size_t newestRows[LAST_OBJECT];
+	
+	// When each device last reported
+	WeatherFlowWatchdog watchdog;
+	EHealthFunction healthCallback;
+	void* healthContext;
+	uint32_t expectedIntervals[LAST_OBJECT];
+	bool staleObjects[LAST_OBJECT];
 
 	// Commonly used strings when parsing objects
+	static const char *OBJECT_TYPES[LAST_OBJECT];
 	static const char *SERIAL_NUMBER;
 	static const char *TYPE;
 	static const char *HUB_SERIAL_NUMBER;
@@ -159,6 +341,14 @@ class WeatherFlowData {
 	static const char *UPTIME;
 	static const char *RSSI;
 	static const char *RADIO_STATS;
+	static const char *RAIN_LAST_HOUR;
+	static const char *RAIN_LAST_24_HOURS;
+	static const char *RAIN_TODAY;
+	static const char *RAIN_RATE;
+	static const char *RAIN_EVENT_START;
+	static const char *RAIN_EVENT_END;
+	static const char *RAIN_EVENT_TOTAL;
+	static const char *RAIN_MISSED_MINUTES;
 
 };
 #endif
@@ -0,0 +1,87 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowDedupe.h"
+
+#define FNV_PRIME (16777619UL)
+
+WeatherFlowDedupe::WeatherFlowDedupe() {
+	reset();
+}
+
+void WeatherFlowDedupe::reset() {
+	for (int i = 0; i < WEATHERFLOW_DEDUPE_SLOTS; i++) {
+		keys[i] = 0;
+		stamps[i] = 0;
+	}
+	duplicateCount = 0;
+}
+
+bool WeatherFlowDedupe::seen(uint32_t key, unsigned long now) {
+	// 0 marks an empty slot
+	if (key == 0)
+		key = 1;
+
+	int freeSlot = -1;
+	int oldestSlot = -1;
+	unsigned long oldestAge = 0;
+	for (int probe = 0; probe < WEATHERFLOW_DEDUPE_PROBES; probe++) {
+		int slot = (key + probe) & (WEATHERFLOW_DEDUPE_SLOTS - 1);
+		unsigned long age = now - stamps[slot];
+		bool expired = keys[slot] == 0 || age > WEATHERFLOW_DEDUPE_AGE_MS;
+
+		if (!expired && keys[slot] == key) {
+			duplicateCount++;
+			return true;
+		}
+		if (expired) {
+			if (freeSlot < 0)
+				freeSlot = slot;
+		} else if (oldestSlot < 0 || age > oldestAge) {
+			oldestSlot = slot;
+			oldestAge = age;
+		}
+	}
+
+	// Table is busy here, so make room by forgetting the oldest packet
+	int slot = freeSlot >= 0 ? freeSlot : oldestSlot;
+	keys[slot] = key;
+	stamps[slot] = now;
+	return false;
+}
+
+uint32_t WeatherFlowDedupe::hash(const char *str, uint32_t h) {
+	if (str) {
+		while (*str) {
+			h ^= (uint8_t)*str++;
+			h *= FNV_PRIME;
+		}
+	}
+	return h;
+}
+
+uint32_t WeatherFlowDedupe::hash(uint32_t value, uint32_t h) {
+	for (int i = 0; i < 4; i++) {
+		h ^= (uint8_t)(value >> (i * 8));
+		h *= FNV_PRIME;
+	}
+	return h;
+}
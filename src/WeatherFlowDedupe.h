@@ -0,0 +1,65 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowDedupe_H
+#define _WeatherFlowDedupe_H
+
+/***
+    Small fixed size cache of recently seen packets. Used to drop
+    the copies of a packet that arrive when more than one hub hears
+    a device, or when a packet is rebroadcast onto the network.
+
+    Packets are identified by a 32 bit hash, stored in an open
+    addressing table. Entries age out after WEATHERFLOW_DEDUPE_AGE_MS.
+ */
+#include "Arduino.h"
+
+// Number of packets remembered, must be a power of two
+#define WEATHERFLOW_DEDUPE_SLOTS (64)
+// Number of slots searched for a packet before giving up
+#define WEATHERFLOW_DEDUPE_PROBES (8)
+// How long a packet is remembered for
+#define WEATHERFLOW_DEDUPE_AGE_MS (60000UL)
+
+class WeatherFlowDedupe {
+  public:
+    WeatherFlowDedupe();
+
+    /* Returns true if key has been seen recently, otherwise it
+       is remembered and false is returned. */
+    bool seen(uint32_t key, unsigned long now);
+
+    /* Number of times seen() has returned true */
+    uint32_t duplicates() const { return duplicateCount; }
+
+    /* Forget all packets */
+    void reset();
+
+    /* Build a key, FNV-1a, from the parts that identify a packet */
+    static uint32_t hash(const char *str, uint32_t h = 2166136261UL);
+    static uint32_t hash(uint32_t value, uint32_t h = 2166136261UL);
+
+  private:
+	uint32_t keys[WEATHERFLOW_DEDUPE_SLOTS];
+	unsigned long stamps[WEATHERFLOW_DEDUPE_SLOTS];
+	uint32_t duplicateCount;
+};
+#endif
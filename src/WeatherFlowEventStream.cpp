@@ -0,0 +1,247 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowEventStream.h"
+#include "WeatherFlowStrings.h"
+#if defined (ESP32)
+#include <errno.h>
+#include <lwip/sockets.h>
+#endif
+
+//#define DEBUG (0)
+
+// Milliseconds allowed for a client to send its request
+#define REQUEST_TIMEOUT (5000)
+// Longest field name
+#define NAME_SIZE (40)
+
+WeatherFlowEventStream::WeatherFlowEventStream(uint16_t port) :
+	server(port),
+	head(0),
+	dropped(0),
+	disconnected(0)
+	{
+	for (int i = 0; i < WEATHERFLOW_STREAM_CLIENTS; i++)
+		clientSlots[i].state = Free;
+}
+
+WeatherFlowEventStream::~WeatherFlowEventStream() {
+}
+
+void WeatherFlowEventStream::begin() {
+	server.begin();
+}
+
+void WeatherFlowEventStream::update() {
+	accept();
+	for (int i = 0; i < WEATHERFLOW_STREAM_CLIENTS; i++) {
+		Client &client = clientSlots[i];
+		if (client.state == Free)
+			continue;
+		if (!client.client.connected()) {
+			close(client);
+			continue;
+		}
+		if (client.state == Request)
+			readRequest(client);
+		if (client.state == Streaming)
+			send(client);
+	}
+}
+
+int WeatherFlowEventStream::clients() {
+	int count = 0;
+	for (int i = 0; i < WEATHERFLOW_STREAM_CLIENTS; i++) {
+		if (clientSlots[i].state == Streaming)
+			count++;
+	}
+	return count;
+}
+
+bool WeatherFlowEventStream::publish(WeatherFlowData &data, WeatherFlowData::Object obj) {
+	// Make room in every client's queue for the new frame
+	for (int i = 0; i < WEATHERFLOW_STREAM_CLIENTS; i++) {
+		Client &client = clientSlots[i];
+		if (client.state != Streaming || head - client.next < WEATHERFLOW_STREAM_QUEUE)
+			continue;
+		if (client.offset > 0) {
+#ifdef DEBUG
+			Serial.println(F("Event stream client too slow, disconnecting"));
+#endif
+			close(client);
+			disconnected++;
+			continue;
+		}
+		client.next++;
+		dropped++;
+	}
+
+	if (!encode(frames[head % WEATHERFLOW_STREAM_QUEUE], data, obj))
+		return false;
+	head++;
+	return true;
+}
+
+// Encode the object once as an event, with a field for each value
+bool WeatherFlowEventStream::encode(WeatherFlowEventStream::Frame &frame, WeatherFlowData &data, WeatherFlowData::Object obj) {
+	JsonDocument doc{WEATHERFLOW_ALLOCATOR};
+	doc["type"] = WeatherFlowData::objectType(obj);
+	for (int keyInt = WeatherFlowData::Serial_Number; keyInt != WeatherFlowData::Last_Value; keyInt++) {
+		WeatherFlowData::Key key = static_cast<WeatherFlowData::Key>(keyInt);
+		JsonVariantConst value = data.getValue(obj, key);
+		if (value.isNull())
+			continue;
+
+		// Field names are the descriptions with no spaces
+		char name[NAME_SIZE];
+		strncpy_P(name, reinterpret_cast<const char *>(WeatherFlowStrings::description_P(key)), NAME_SIZE - 1);
+		name[NAME_SIZE - 1] = '\0';
+		for (char *c = name; *c; c++) {
+			if (*c == ' ')
+				*c = '_';
+		}
+		doc[name] = value;
+	}
+
+	int length = snprintf(frame.data, sizeof(frame.data), "id: %lu\nevent: %s\ndata: ",
+		(unsigned long)head, WeatherFlowData::objectType(obj));
+	if (length < 0 || length + measureJson(doc) + 2 >= sizeof(frame.data)) {
+#ifdef DEBUG
+		Serial.println(F("Event too large for a frame"));
+#endif
+		frame.length = 0;
+		return false;
+	}
+	length += serializeJson(doc, frame.data + length, sizeof(frame.data) - length);
+	frame.data[length++] = '\n';
+	frame.data[length++] = '\n';
+	frame.length = length;
+	return true;
+}
+
+void WeatherFlowEventStream::accept() {
+	WiFiClient incoming = server.available();
+	if (!incoming)
+		return;
+
+	for (int i = 0; i < WEATHERFLOW_STREAM_CLIENTS; i++) {
+		Client &client = clientSlots[i];
+		if (client.state != Free)
+			continue;
+		client.client = incoming;
+		client.state = Request;
+		client.newlines = 0;
+		client.lastActive = millis();
+		return;
+	}
+	// No room for another client
+	incoming.stop();
+}
+
+// Any request is answered with the stream, once its headers have
+// been read
+void WeatherFlowEventStream::readRequest(WeatherFlowEventStream::Client &client) {
+	while (client.client.available()) {
+		int c = client.client.read();
+		if (c == '\r')
+			continue;
+		if (c != '\n') {
+			client.newlines = 0;
+			continue;
+		}
+		if (++client.newlines < 2)
+			continue;
+
+		client.client.print(F("HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/event-stream\r\n"
+			"Cache-Control: no-cache\r\n"
+			"Connection: keep-alive\r\n"
+			"Access-Control-Allow-Origin: *\r\n\r\n"));
+		client.state = Streaming;
+		client.next = head;
+		client.offset = 0;
+		client.lastActive = millis();
+		return;
+	}
+
+	if (millis() - client.lastActive > REQUEST_TIMEOUT)
+		close(client);
+}
+
+// Write as much of the client's queue as it will take without waiting
+void WeatherFlowEventStream::send(WeatherFlowEventStream::Client &client) {
+	unsigned long now = millis();
+	while (client.next != head) {
+		const Frame &frame = frames[client.next % WEATHERFLOW_STREAM_QUEUE];
+		int written = write(client, frame.data + client.offset, frame.length - client.offset);
+		if (written < 0) {
+			close(client);
+			return;
+		}
+		if (written == 0)
+			break;
+		client.offset += written;
+		client.lastActive = now;
+		if (client.offset == frame.length) {
+			client.offset = 0;
+			client.next++;
+		}
+	}
+
+	// Keep proxies from closing a quiet connection
+	if (client.next == head && now - client.lastActive >= WEATHERFLOW_STREAM_KEEPALIVE) {
+		int written = write(client, ":\n\n", 3);
+		// Half a comment would run into the next frame
+		if (written > 0 && written < 3) {
+			close(client);
+			return;
+		}
+		if (written == 3)
+			client.lastActive = now;
+	}
+}
+
+// Write what the client's socket will take now, without blocking.
+// Returns the bytes written, or -1 if the connection has failed.
+int WeatherFlowEventStream::write(WeatherFlowEventStream::Client &client, const char *data, size_t length) {
+#if defined (ESP32)
+	// WiFiClient::write() retries until everything is sent, so send
+	// to the socket directly
+	int sent = ::send(client.client.fd(), data, length, MSG_DONTWAIT);
+	if (sent < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	return sent;
+#else
+#if defined (ESP8266)
+	size_t room = client.client.availableForWrite();
+	if (room == 0)
+		return 0;
+	if (length > room)
+		length = room;
+#endif
+	return client.client.write((const uint8_t*)data, length);
+#endif
+}
+
+void WeatherFlowEventStream::close(WeatherFlowEventStream::Client &client) {
+	client.client.stop();
+	client.state = Free;
+}
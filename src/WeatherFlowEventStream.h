@@ -0,0 +1,118 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowEventStream_H
+#define _WeatherFlowEventStream_H
+
+/***
+    Pushes objects to browsers and dashboards as Server-Sent Events,
+    instead of them polling for every value.
+
+    Each published object is encoded once into a frame in a shared
+    ring, and the same bytes are written to every connected client.
+    A client's queue is the frames it has not yet been sent, at most
+    WEATHERFLOW_STREAM_QUEUE. When a slow client's queue is full its
+    oldest unsent frame is dropped; a client still part way through
+    the frame being replaced is disconnected.
+
+    Each event looks like:
+      id: 42
+      event: obs_st
+      data: {"type":"obs_st","Serial_Number":"ST-00000512",...}
+
+    and can be read in a browser with
+      new EventSource("http://<address>:<port>/").addEventListener("obs_st", ...)
+ */
+#include "Arduino.h"
+#include "WeatherFlowData.h"
+#include <WiFiServer.h>
+#include <WiFiClient.h>
+
+// Number of clients connected at once
+#define WEATHERFLOW_STREAM_CLIENTS (4)
+// Frames waiting for each client
+#define WEATHERFLOW_STREAM_QUEUE (8)
+// Largest encoded frame
+#define WEATHERFLOW_STREAM_FRAME_SIZE (1024)
+// Milliseconds of quiet before a keep alive comment is sent
+#define WEATHERFLOW_STREAM_KEEPALIVE (15000)
+
+class WeatherFlowEventStream {
+  public:
+    WeatherFlowEventStream(uint16_t port = 80);
+    ~WeatherFlowEventStream();
+
+    /* Start accepting clients */
+    void begin();
+
+    /* Accept new clients and send waiting frames. Call regularly */
+    void update();
+
+    /* Encode the object, as returned by data.getValue(obj, key), and
+       queue it for every client. Call from the WeatherFlowData
+       callback. Returns false if it did not fit in a frame */
+    bool publish(WeatherFlowData &data, WeatherFlowData::Object obj);
+
+    /* Number of connected clients */
+    int clients();
+
+    /* Frames dropped for slow clients, and slow clients disconnected */
+    uint32_t droppedFrames() const { return dropped; }
+    uint32_t droppedClients() const { return disconnected; }
+
+  private:
+	enum State {
+		Free,
+		Request,	// Reading the request headers
+		Streaming
+	};
+
+	struct Client {
+		WiFiClient client;
+		State state;
+		uint8_t newlines;	// Consecutive line ends read
+		uint32_t next;		// Frame being sent
+		size_t offset;		// Bytes of it already sent
+		unsigned long lastActive;
+	};
+
+	struct Frame {
+		char data[WEATHERFLOW_STREAM_FRAME_SIZE];
+		size_t length;
+	};
+
+	void accept();
+	void readRequest(Client &client);
+	void send(Client &client);
+	int write(Client &client, const char *data, size_t length);
+	void close(Client &client);
+	bool encode(Frame &frame, WeatherFlowData &data, WeatherFlowData::Object obj);
+
+	WiFiServer server;
+	Client clientSlots[WEATHERFLOW_STREAM_CLIENTS];
+
+	Frame frames[WEATHERFLOW_STREAM_QUEUE];
+	uint32_t head;		// Number of the next frame published
+
+	uint32_t dropped;
+	uint32_t disconnected;
+};
+#endif
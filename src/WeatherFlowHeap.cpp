@@ -0,0 +1,206 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowHeap.h"
+#include "WeatherFlowData.h"
+#include "WeatherFlowStrings.h"
+
+static_assert(WEATHERFLOW_HEAP_OBJECTS == WeatherFlowData::LAST_OBJECT + 1, "one heap slot per object");
+
+// Slot for blocks not allocated for a particular object
+#define UNTAGGED (WEATHERFLOW_HEAP_OBJECTS - 1)
+
+WeatherFlowHeap::WeatherFlowHeap() :
+	currentSite(Other),
+	currentObject(UNTAGGED)
+	{
+	memset(sites, 0, sizeof(sites));
+	memset(objects, 0, sizeof(objects));
+	memset(&totals, 0, sizeof(totals));
+}
+
+WeatherFlowHeap *WeatherFlowHeap::instance() {
+	static WeatherFlowHeap heap;
+	return &heap;
+}
+
+void* WeatherFlowHeap::allocate(size_t size) {
+	Header *header = (Header*)malloc(sizeof(Header) + size);
+	Header tag;
+	tag.info.size = size;
+	tag.info.site = currentSite;
+	tag.info.object = currentObject;
+	if (!header) {
+		count(tag, &Stats::failures);
+		return 0;
+	}
+	*header = tag;
+	count(*header, &Stats::allocations);
+	added(*header);
+	return header + 1;
+}
+
+void WeatherFlowHeap::deallocate(void* ptr) {
+	if (!ptr)
+		return;
+	Header *header = (Header*)ptr - 1;
+	count(*header, &Stats::frees);
+	removed(*header);
+	free(header);
+}
+
+// A block stays with the site and object it was allocated for
+void* WeatherFlowHeap::reallocate(void* ptr, size_t new_size) {
+	if (!ptr)
+		return allocate(new_size);
+	Header *header = (Header*)ptr - 1;
+	Header old = *header;
+	header = (Header*)realloc(header, sizeof(Header) + new_size);
+	if (!header) {
+		count(old, &Stats::failures);
+		return 0;
+	}
+	removed(old);
+	header->info.size = new_size;
+	count(*header, &Stats::reallocations);
+	added(*header);
+	return header + 1;
+}
+
+void WeatherFlowHeap::count(const WeatherFlowHeap::Header &header, uint32_t WeatherFlowHeap::Stats::*counter) {
+	sites[header.info.site].*counter += 1;
+	objects[header.info.object].*counter += 1;
+	totals.*counter += 1;
+}
+
+void WeatherFlowHeap::added(const WeatherFlowHeap::Header &header) {
+	Stats *targets[] = { &sites[header.info.site], &objects[header.info.object], &totals };
+	for (Stats *stats : targets) {
+		stats->bytes += header.info.size;
+		stats->live += header.info.size;
+		stats->blocks++;
+		if (stats->live > stats->peak)
+			stats->peak = stats->live;
+	}
+}
+
+void WeatherFlowHeap::removed(const WeatherFlowHeap::Header &header) {
+	Stats *targets[] = { &sites[header.info.site], &objects[header.info.object], &totals };
+	for (Stats *stats : targets) {
+		stats->live -= header.info.size;
+		stats->blocks--;
+	}
+}
+
+void WeatherFlowHeap::reset() {
+	Stats *targets[LAST_SITE + WEATHERFLOW_HEAP_OBJECTS + 1];
+	int count = 0;
+	for (int i = 0; i < LAST_SITE; i++)
+		targets[count++] = &sites[i];
+	for (int i = 0; i < WEATHERFLOW_HEAP_OBJECTS; i++)
+		targets[count++] = &objects[i];
+	targets[count++] = &totals;
+
+	for (int i = 0; i < count; i++) {
+		Stats *stats = targets[i];
+		uint32_t live = stats->live;
+		uint32_t blocks = stats->blocks;
+		memset(stats, 0, sizeof(Stats));
+		stats->live = live;
+		stats->peak = live;
+		stats->blocks = blocks;
+	}
+}
+
+int WeatherFlowHeap::fragmentation() {
+#if defined (ESP8266)
+	return ESP.getHeapFragmentation();
+#elif defined (ESP32)
+	uint32_t free = ESP.getFreeHeap();
+	if (!free)
+		return 0;
+	return 100 - (int)((uint64_t)ESP.getMaxAllocHeap() * 100 / free);
+#else
+	return 0;
+#endif
+}
+
+void WeatherFlowHeap::printStats(Print &out, const WeatherFlowHeap::Stats &stats) {
+	out.print(F(": allocations "));
+	out.print(stats.allocations);
+	out.print(F(" frees "));
+	out.print(stats.frees);
+	out.print(F(" reallocations "));
+	out.print(stats.reallocations);
+	out.print(F(" failures "));
+	out.print(stats.failures);
+	out.print(F(" bytes "));
+	out.print(stats.bytes);
+	out.print(F(" live "));
+	out.print(stats.live);
+	out.print(F(" peak "));
+	out.print(stats.peak);
+	out.print(F(" blocks "));
+	out.println(stats.blocks);
+}
+
+void WeatherFlowHeap::printTo(Print &out) {
+#ifndef WEATHERFLOW_HEAP_PROFILE
+	out.println(F("Heap profiling is off, define WEATHERFLOW_HEAP_PROFILE"));
+#endif
+	out.print(F("Total"));
+	printStats(out, totals);
+	out.print(F("Heap fragmentation: "));
+	out.print(fragmentation());
+	out.println(F("%"));
+
+	static const char *const siteNames[LAST_SITE] = { "other", "processPacket", "update", "lastObject" };
+	for (int i = 0; i < LAST_SITE; i++) {
+		out.print(F("Site "));
+		out.print(siteNames[i]);
+		printStats(out, sites[i]);
+	}
+
+	for (int i = 0; i < WEATHERFLOW_HEAP_OBJECTS; i++) {
+		out.print(F("Object "));
+		if (i == UNTAGGED)
+			out.print(F("none"));
+		else
+			out.print(WeatherFlowStrings::description_P(static_cast<WeatherFlowData::Object>(i)));
+		printStats(out, objects[i]);
+	}
+}
+
+WeatherFlowHeap::Tag::Tag(int site, int obj) {
+	WeatherFlowHeap *heap = instance();
+	savedSite = heap->currentSite;
+	savedObject = heap->currentObject;
+	if (site >= 0)
+		heap->currentSite = site;
+	if (obj >= 0)
+		heap->currentObject = obj < UNTAGGED ? obj : UNTAGGED;
+}
+
+WeatherFlowHeap::Tag::~Tag() {
+	WeatherFlowHeap *heap = instance();
+	heap->currentSite = savedSite;
+	heap->currentObject = savedObject;
+}
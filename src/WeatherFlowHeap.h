@@ -0,0 +1,148 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowHeap_H
+#define _WeatherFlowHeap_H
+
+/***
+    Optional heap profiling of the library's JSON documents.
+
+    When WEATHERFLOW_HEAP_PROFILE is defined, every JsonDocument the
+    library creates uses WeatherFlowHeap as its allocator. Each block
+    carries a small header recording its size and the call site and
+    object type it was allocated for, so that allocations, frees,
+    live bytes and peak bytes can be kept for each call site
+    (processPacket, update, lastObject) and for each stored object.
+    The header adds 8 bytes to every block.
+
+    Without WEATHERFLOW_HEAP_PROFILE, documents use the ArduinoJson
+    default allocator and the tags below compile to nothing.
+ */
+#include "Arduino.h"
+#include "ArduinoJson.h"
+
+// Uncomment, or define for the build, to profile the JSON heap
+//#define WEATHERFLOW_HEAP_PROFILE
+
+// One slot for each WeatherFlowData::Object, and one for blocks not
+// allocated for a particular object
+#define WEATHERFLOW_HEAP_OBJECTS (8 + 1)
+
+// Constructor argument for the library's documents. Without profiling
+// it is empty, so documents are default constructed and use
+// ArduinoJson's own allocator. Write member initializers as
+// doc(WEATHERFLOW_ALLOCATOR) and declarations as doc{WEATHERFLOW_ALLOCATOR}
+// so that both still parse when it is empty.
+#ifdef WEATHERFLOW_HEAP_PROFILE
+#define WEATHERFLOW_ALLOCATOR WeatherFlowHeap::instance()
+// Tag allocations in the enclosing scope with a call site, or object
+#define WEATHERFLOW_HEAP_SITE(site) WeatherFlowHeap::Tag heapSiteTag(WeatherFlowHeap::site, -1)
+#define WEATHERFLOW_HEAP_OBJECT(obj) WeatherFlowHeap::Tag heapObjectTag(-1, obj)
+#else
+#define WEATHERFLOW_ALLOCATOR
+#define WEATHERFLOW_HEAP_SITE(site)
+#define WEATHERFLOW_HEAP_OBJECT(obj)
+#endif
+
+class WeatherFlowHeap : public ArduinoJson::Allocator {
+  public:
+	/* Where an allocation was made */
+	enum Site {
+		Other,
+		Process_Packet,
+		Update,
+		Last_Object,
+
+		LAST_SITE
+	};
+
+	/* Counts kept for each site, each object and in total */
+	struct Stats {
+		uint32_t allocations;
+		uint32_t frees;
+		uint32_t reallocations;
+		uint32_t failures;
+		uint32_t bytes;		// Total bytes ever allocated
+		uint32_t live;		// Bytes allocated and not yet freed
+		uint32_t peak;		// Most bytes live at once
+		uint32_t blocks;	// Blocks allocated and not yet freed
+	};
+
+	/* The allocator used by all library documents */
+	static WeatherFlowHeap *instance();
+
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t new_size) override;
+
+	const Stats& site(Site site) const { return sites[site]; }
+	/* Stats for a WeatherFlowData::Object, or LAST_OBJECT for blocks
+	   not allocated for a particular object */
+	const Stats& object(int obj) const { return objects[obj]; }
+	const Stats& total() const { return totals; }
+
+	/* Percentage of the free system heap that is not in the largest
+	   free block, 0 if the platform does not say */
+	static int fragmentation();
+
+	/* Clear the counts. Live bytes and blocks are kept */
+	void reset();
+
+	/* Print all the counts as text */
+	void printTo(Print &out);
+
+	/* Tags allocations made while it is in scope with a site and/or
+	   object, -1 to keep the enclosing one */
+	class Tag {
+	  public:
+		Tag(int site, int obj);
+		~Tag();
+	  private:
+		uint8_t savedSite;
+		uint8_t savedObject;
+	};
+
+  private:
+	WeatherFlowHeap();
+
+	// Kept in front of every block
+	union Header {
+		struct {
+			uint32_t size;
+			uint8_t site;
+			uint8_t object;
+		} info;
+		double align;
+	};
+
+	void count(const Header &header, uint32_t Stats::*counter);
+	void added(const Header &header);
+	void removed(const Header &header);
+	static void printStats(Print &out, const Stats &stats);
+
+	Stats sites[LAST_SITE];
+	Stats objects[WEATHERFLOW_HEAP_OBJECTS];
+	Stats totals;
+
+	uint8_t currentSite;
+	uint8_t currentObject;
+};
+#endif
@@ -0,0 +1,196 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowRain.h"
+
+#define SECONDS_PER_DAY (86400L)
+
+WeatherFlowRain::WeatherFlowRain() :
+	dayOffset(0)
+	{
+	reset();
+}
+
+void WeatherFlowRain::reset() {
+	for (int i = 0; i < 60; i++) {
+		minuteAmount[i] = 0;
+		minuteTag[i] = 0;
+	}
+	for (int i = 0; i < 24; i++) {
+		hourAmount[i] = 0;
+		hourTag[i] = 0;
+	}
+	newestMinute = 0;
+	firstMinute = 0;
+	lastRainEpoch = 0;
+	currentDay = 0;
+	missed = 0;
+	hourTotal = 0;
+	dayTotal = 0;
+	todayTotal = 0;
+	lastRate = 0;
+	eventStartEpoch = 0;
+	eventEndEpoch = 0;
+	eventAmount = 0;
+}
+
+void WeatherFlowRain::setDayOffset(int32_t seconds) {
+	dayOffset = seconds;
+	if (newestMinute) {
+		uint32_t day = dayOf(newestMinute * 60);
+		if (day != currentDay) {
+			currentDay = day;
+			todayTotal = 0;
+		}
+	}
+}
+
+uint32_t WeatherFlowRain::dayOf(uint32_t epoch) const {
+	return (uint32_t)(((int64_t)epoch + dayOffset) / SECONDS_PER_DAY);
+}
+
+// Move the newest minute forward, expiring any minutes and hours
+// that fall out of the rolling windows. At most 60 minute slots and
+// 24 hour slots are touched, however large the jump.
+void WeatherFlowRain::advanceTo(uint32_t minute) {
+	if (newestMinute == 0 || minute - newestMinute >= 60) {
+		for (int i = 0; i < 60; i++) {
+			minuteAmount[i] = 0;
+			minuteTag[i] = 0;
+		}
+		hourTotal = 0;
+	} else {
+		for (uint32_t m = newestMinute + 1; m <= minute; m++) {
+			uint8_t slot = m % 60;
+			hourTotal -= minuteAmount[slot];
+			minuteAmount[slot] = 0;
+			minuteTag[slot] = 0;
+		}
+		if (hourTotal < 0)
+			hourTotal = 0;
+	}
+
+	uint32_t hour = minute / 60;
+	uint32_t oldHour = newestMinute / 60;
+	if (newestMinute == 0 || hour - oldHour >= 24) {
+		for (int i = 0; i < 24; i++) {
+			hourAmount[i] = 0;
+			hourTag[i] = 0;
+		}
+		dayTotal = 0;
+		hourTag[hour % 24] = hour + 1;
+	} else {
+		for (uint32_t h = oldHour + 1; h <= hour; h++) {
+			uint8_t slot = h % 24;
+			dayTotal -= hourAmount[slot];
+			hourAmount[slot] = 0;
+			hourTag[slot] = h + 1;
+		}
+		if (dayTotal < 0)
+			dayTotal = 0;
+	}
+
+	uint32_t day = dayOf(minute * 60);
+	if (day != currentDay) {
+		currentDay = day;
+		todayTotal = 0;
+	}
+
+	newestMinute = minute;
+	lastRate = 0;
+}
+
+bool WeatherFlowRain::addMinute(uint32_t epoch, float amount) {
+	if (epoch == 0)
+		return false;
+	if (amount < 0)
+		amount = 0;
+
+	uint32_t minute = epoch / 60;
+	if (newestMinute == 0 || minute > newestMinute) {
+		if (newestMinute == 0)
+			firstMinute = minute;
+		else if (minute > newestMinute + 1)
+			missed += minute - newestMinute - 1;
+		advanceTo(minute);
+	} else if (newestMinute - minute >= 60) {
+		// Too old to tell if it has already been counted
+		return false;
+	}
+
+	uint8_t slot = minute % 60;
+	if (minuteTag[slot] == minute + 1)
+		return false;
+
+	// A late minute that was previously counted as missed
+	if (minute < newestMinute && minute > firstMinute && minuteTag[slot] == 0 && missed > 0)
+		missed--;
+
+	minuteAmount[slot] += amount;
+	minuteTag[slot] = minute + 1;
+	hourTotal += amount;
+
+	uint32_t hour = minute / 60;
+	uint8_t hourSlot = hour % 24;
+	if (hourTag[hourSlot] != hour + 1) {
+		dayTotal -= hourAmount[hourSlot];
+		hourAmount[hourSlot] = 0;
+		hourTag[hourSlot] = hour + 1;
+	}
+	hourAmount[hourSlot] += amount;
+	dayTotal += amount;
+
+	if (dayOf(epoch) == currentDay)
+		todayTotal += amount;
+
+	if (minute == newestMinute)
+		lastRate = minuteAmount[slot] * 60;
+
+	if (amount > 0) {
+		if (eventActive()) {
+			eventAmount += amount;
+		} else if (epoch > eventEndEpoch) {
+			eventStartEpoch = epoch;
+			eventEndEpoch = 0;
+			eventAmount = amount;
+		} else {
+			// Late rain that belongs to the event that already ended
+			eventAmount += amount;
+		}
+		if (epoch > lastRainEpoch)
+			lastRainEpoch = epoch;
+	}
+
+	if (eventActive() && newestMinute - lastRainEpoch / 60 >= WEATHERFLOW_RAIN_EVENT_DRY_MINUTES)
+		eventEndEpoch = lastRainEpoch;
+
+	return true;
+}
+
+void WeatherFlowRain::startEvent(uint32_t epoch) {
+	if (!eventActive()) {
+		eventStartEpoch = epoch;
+		eventEndEpoch = 0;
+		eventAmount = 0;
+	}
+	if (epoch > lastRainEpoch)
+		lastRainEpoch = epoch;
+}
@@ -0,0 +1,112 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowRain_H
+#define _WeatherFlowRain_H
+
+/***
+    Keeps running precipitation totals from the per minute rain
+    amounts reported in observations. Each observation is keyed by
+    the minute of its Time_Epoch so repeated packets are only counted
+    once, and skipped minutes are counted as missed.
+
+    All updates take constant time; nothing is re-summed on read.
+ */
+#include "Arduino.h"
+
+// Minutes without rain before a precipitation event is considered over
+#define WEATHERFLOW_RAIN_EVENT_DRY_MINUTES (30)
+// Stations whose totals are kept at once
+#ifndef WEATHERFLOW_RAIN_STATIONS
+#define WEATHERFLOW_RAIN_STATIONS (4)
+#endif
+
+class WeatherFlowRain {
+  public:
+    WeatherFlowRain();
+
+    /* Add the rain (mm) reported for the minute ending at epoch.
+       Returns false if the minute was already counted or is too
+       old to be placed. */
+    bool addMinute(uint32_t epoch, float amount);
+
+    /* Mark the start of a precipitation event (evt_precip) */
+    void startEvent(uint32_t epoch);
+
+    /* Offset in seconds from UTC used to find the start of "today" */
+    void setDayOffset(int32_t seconds);
+
+    /* Rolling total over the previous 60 minutes */
+    float lastHour() const { return hourTotal; }
+
+    /* Rolling total over the previous 24 hours, at hourly resolution */
+    float last24Hours() const { return dayTotal; }
+
+    /* Total since local midnight */
+    float today() const { return todayTotal; }
+
+    /* Rate (mm/h) from the most recent minute */
+    float rate() const { return lastRate; }
+
+    /* Boundaries and total of the current, or most recent, event.
+       Epochs are 0 when not known; end is 0 while the event is active */
+    uint32_t eventStart() const { return eventStartEpoch; }
+    uint32_t eventEnd() const { return eventEndEpoch; }
+    float eventTotal() const { return eventAmount; }
+    bool eventActive() const { return eventStartEpoch != 0 && eventEndEpoch == 0; }
+
+    /* Number of minutes that have not been reported */
+    uint32_t missedMinutes() const { return missed; }
+
+    /* Forget all history */
+    void reset();
+
+  private:
+	void advanceTo(uint32_t minute);
+	uint32_t dayOf(uint32_t epoch) const;
+
+	// Per minute amounts for the last hour, slot is minute % 60.
+	// The tag holds the minute number + 1, 0 if empty.
+	float minuteAmount[60];
+	uint32_t minuteTag[60];
+
+	// Per hour amounts for the last day, slot is hour % 24.
+	// The tag holds the hour number + 1, 0 if empty.
+	float hourAmount[24];
+	uint32_t hourTag[24];
+
+	uint32_t newestMinute;
+	uint32_t firstMinute;
+	uint32_t lastRainEpoch;
+	uint32_t currentDay;
+	int32_t dayOffset;
+	uint32_t missed;
+
+	float hourTotal;
+	float dayTotal;
+	float todayTotal;
+	float lastRate;
+
+	uint32_t eventStartEpoch;
+	uint32_t eventEndEpoch;
+	float eventAmount;
+};
+#endif
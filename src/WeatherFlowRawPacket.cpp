@@ -0,0 +1,337 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowRawPacket.h"
+
+// Position of a value that is null, or was not kept
+#define NO_POSITION (0xFF)
+
+WeatherFlowRawPacket::WeatherFlowRawPacket() :
+	textLength(0),
+	memberCount(0),
+	elementCount(0),
+	cache(WEATHERFLOW_ALLOCATOR),
+	scratch(WEATHERFLOW_ALLOCATOR),
+	cacheCount(0),
+	cachedKeys(0),
+	rowValueCount(0),
+	cachedRow(0)
+	{
+	buffer[0] = '\0';
+}
+
+bool WeatherFlowRawPacket::parse(const char *packet, size_t length) {
+	memberCount = 0;
+	elementCount = 0;
+	cache.clear();
+	cacheCount = 0;
+	cachedKeys = 0;
+	rowValueCount = 0;
+	cachedRow = 0;
+	textLength = 0;
+	buffer[0] = '\0';
+	if (!packet || length >= WEATHERFLOW_RAW_PACKET_SIZE)
+		return false;
+
+	memcpy(buffer, packet, length);
+	buffer[length] = '\0';
+	textLength = length;
+
+	int pos = skipSpace(0);
+	if (buffer[pos] != '{')
+		return false;
+	pos = skipSpace(pos + 1);
+	while (buffer[pos] != '}') {
+		if (buffer[pos] != '"')
+			return false;
+		int keyEnd = skipString(pos);
+		if (keyEnd < 0)
+			return false;
+		int colon = skipSpace(keyEnd);
+		if (buffer[colon] != ':')
+			return false;
+		int value = skipSpace(colon + 1);
+		int end = skipValue(value);
+		if (end < 0)
+			return false;
+
+		if (memberCount < WEATHERFLOW_RAW_MEMBERS) {
+			Member &member = members[memberCount++];
+			member.key = pos + 1;
+			member.keyLength = keyEnd - pos - 2;
+			member.value = value;
+			member.firstElement = elementCount;
+			member.elementCount = 0;
+			member.nested = false;
+			if (buffer[value] == '[')
+				indexElements(member);
+		}
+
+		pos = skipSpace(end);
+		if (buffer[pos] == ',')
+			pos = skipSpace(pos + 1);
+		else if (buffer[pos] != '}')
+			return false;
+	}
+	return true;
+}
+
+// Record where each element of the array starts. For an array of
+// arrays, like obs, the elements of the first row are recorded.
+void WeatherFlowRawPacket::indexElements(WeatherFlowRawPacket::Member &member) {
+	int pos = member.value;
+	int first = skipSpace(pos + 1);
+	if (buffer[first] == '[') {
+		member.nested = true;
+		pos = first;
+	}
+
+	int i = skipSpace(pos + 1);
+	while (buffer[i] != ']' && elementCount < WEATHERFLOW_RAW_ELEMENTS) {
+		elements[elementCount++] = i;
+		member.elementCount++;
+		i = skipValue(i);
+		if (i < 0)
+			return;
+		i = skipSpace(i);
+		if (buffer[i] != ',')
+			return;
+		i = skipSpace(i + 1);
+	}
+}
+
+JsonVariantConst WeatherFlowRawPacket::get(const char *member, int index1, int index2, int cacheKey, int row) {
+	bool cacheable = cacheKey >= 0 && cacheKey < 64;
+	bool otherRow = cacheable && row >= 0 && (size_t)row != cachedRow;
+	if (otherRow) {
+		for (int i = 0; i < rowValueCount; i++) {
+			if (rowValues[i].row == row && rowValues[i].key == cacheKey)
+				return rowValues[i].position == NO_POSITION ? JsonVariantConst() : cached(rowValues[i].position);
+		}
+	} else if (cacheable && (cachedKeys & (1ULL << cacheKey))) {
+		return keyPositions[cacheKey] == NO_POSITION ? JsonVariantConst() : cached(keyPositions[cacheKey]);
+	}
+
+	int pos = -1;
+	const Member *found = findMember(member);
+	if (found) {
+		pos = found->value;
+		if (index1 >= 0) {
+			if (found->nested && index1 == 0 && index2 >= 0 && index2 < found->elementCount) {
+				pos = elements[found->firstElement + index2];
+				index2 = -1;
+			} else if (!found->nested && index1 < found->elementCount) {
+				pos = elements[found->firstElement + index1];
+			} else {
+				pos = arrayElement(pos, index1);
+			}
+			if (pos >= 0 && index2 >= 0)
+				pos = arrayElement(pos, index2);
+		}
+	}
+
+	convert(pos);
+	if (!cacheable)
+		return scratch.as<JsonVariantConst>();
+
+	// Values past the end of the tables are still kept, so they do not
+	// change, but are converted again when asked for
+	uint8_t position = keep();
+	if (scratch.isNull() || position != NO_POSITION) {
+		if (!otherRow) {
+			keyPositions[cacheKey] = position;
+			cachedKeys |= 1ULL << cacheKey;
+		} else if (rowValueCount < WEATHERFLOW_RAW_ROW_VALUES && row < 256) {
+			RowValue &value = rowValues[rowValueCount++];
+			value.row = row;
+			value.key = cacheKey;
+			value.position = position;
+		}
+	}
+	// Nulls are not kept, and are returned unbound so that they do not
+	// change with the next conversion
+	if (scratch.isNull())
+		return JsonVariantConst();
+	return cached(cacheCount - 1);
+}
+
+// Append the value in scratch to the cache. Returns its position, or
+// NO_POSITION if it is null or there are too many to number.
+uint8_t WeatherFlowRawPacket::keep() {
+	if (scratch.isNull())
+		return NO_POSITION;
+	cache.add(scratch.as<JsonVariantConst>());
+	cacheCount++;
+	return cacheCount <= NO_POSITION ? cacheCount - 1 : NO_POSITION;
+}
+
+JsonVariantConst WeatherFlowRawPacket::cached(uint16_t position) {
+	return cache.as<JsonArrayConst>()[position];
+}
+
+// Convert the value at pos into scratch. Numbers are converted
+// directly, anything else is handed to the JSON parser.
+void WeatherFlowRawPacket::convert(int pos) {
+	scratch.clear();
+	if (pos < 0)
+		return;
+	int end = skipValue(pos);
+	if (end < 0)
+		return;
+
+	char c = buffer[pos];
+	if (c == '-' || (c >= '0' && c <= '9')) {
+		bool real = false;
+		for (int i = pos; i < end; i++) {
+			if (buffer[i] == '.' || buffer[i] == 'e' || buffer[i] == 'E')
+				real = true;
+		}
+		if (real)
+			scratch.set(strtod(buffer + pos, 0));
+		else if (c == '-')
+			scratch.set(strtol(buffer + pos, 0, 10));
+		else
+			scratch.set(strtoul(buffer + pos, 0, 10));
+	} else {
+		deserializeJson(scratch, buffer + pos, end - pos);
+	}
+}
+
+bool WeatherFlowRawPacket::equals(const char *member, const char *value) const {
+	const Member *found = findMember(member);
+	if (!found || buffer[found->value] != '"')
+		return false;
+	size_t length = strlen(value);
+	return strncmp(buffer + found->value + 1, value, length) == 0 && buffer[found->value + 1 + length] == '"';
+}
+
+size_t WeatherFlowRawPacket::arraySize(const char *member) const {
+	const Member *found = findMember(member);
+	if (!found || buffer[found->value] != '[')
+		return 0;
+
+	size_t count = 0;
+	int i = skipSpace(found->value + 1);
+	while (buffer[i] != ']') {
+		count++;
+		i = skipValue(i);
+		if (i < 0)
+			break;
+		i = skipSpace(i);
+		if (buffer[i] != ',')
+			break;
+		i = skipSpace(i + 1);
+	}
+	return count;
+}
+
+void WeatherFlowRawPacket::setCacheRow(size_t row) {
+	if (row != cachedRow) {
+		cachedRow = row;
+		cache.clear();
+		cacheCount = 0;
+		cachedKeys = 0;
+		rowValueCount = 0;
+	}
+}
+
+const WeatherFlowRawPacket::Member *WeatherFlowRawPacket::findMember(const char *member) const {
+	if (!member)
+		return 0;
+	size_t length = strlen(member);
+	for (int i = 0; i < memberCount; i++) {
+		if (members[i].keyLength == length && strncmp(buffer + members[i].key, member, length) == 0)
+			return &members[i];
+	}
+	return 0;
+}
+
+int WeatherFlowRawPacket::skipSpace(int pos) const {
+	while (pos < (int)textLength && (buffer[pos] == ' ' || buffer[pos] == '\t' || buffer[pos] == '\r' || buffer[pos] == '\n'))
+		pos++;
+	return pos;
+}
+
+// Position just after the value starting at pos, -1 if malformed
+int WeatherFlowRawPacket::skipValue(int pos) const {
+	if (pos < 0 || pos >= (int)textLength)
+		return -1;
+
+	char c = buffer[pos];
+	if (c == '"')
+		return skipString(pos);
+
+	if (c == '[' || c == '{') {
+		int depth = 0;
+		int i = pos;
+		while (i < (int)textLength) {
+			c = buffer[i];
+			if (c == '"') {
+				i = skipString(i);
+				if (i < 0)
+					return -1;
+				continue;
+			}
+			if (c == '[' || c == '{')
+				depth++;
+			else if (c == ']' || c == '}') {
+				if (--depth == 0)
+					return i + 1;
+			}
+			i++;
+		}
+		return -1;
+	}
+
+	int i = pos;
+	while (i < (int)textLength && !strchr(",]} \t\r\n", buffer[i]))
+		i++;
+	return i > pos ? i : -1;
+}
+
+int WeatherFlowRawPacket::skipString(int pos) const {
+	for (int i = pos + 1; i < (int)textLength; i++) {
+		if (buffer[i] == '\\')
+			i++;
+		else if (buffer[i] == '"')
+			return i + 1;
+	}
+	return -1;
+}
+
+// Position of element index of the array starting at pos, -1 if none
+int WeatherFlowRawPacket::arrayElement(int pos, int index) const {
+	if (pos < 0 || buffer[pos] != '[')
+		return -1;
+	int i = skipSpace(pos + 1);
+	for (int n = 0; buffer[i] != ']'; n++) {
+		if (n == index)
+			return i;
+		i = skipValue(i);
+		if (i < 0)
+			return -1;
+		i = skipSpace(i);
+		if (buffer[i] != ',')
+			return -1;
+		i = skipSpace(i + 1);
+	}
+	return -1;
+}
@@ -0,0 +1,126 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowRawPacket_H
+#define _WeatherFlowRawPacket_H
+
+/***
+    Holds the raw JSON text of a WeatherFlow packet in a fixed size
+    buffer, with an index of where each top level member starts and
+    where the elements of its array (the first row of obs) start.
+    The index is built when the packet is parsed, without converting
+    any values.
+
+    Values are only converted from text when they are asked for,
+    and are then cached until the next packet is parsed. Cached
+    values are appended to one array in the order they are asked
+    for, and found again through a position for each key of the
+    cache row, and a short table for the other rows.
+ */
+#include "Arduino.h"
+#include "ArduinoJson.h"
+#include "WeatherFlowHeap.h"
+
+// Largest packet that can be held, including terminator
+#define WEATHERFLOW_RAW_PACKET_SIZE (512)
+// Number of top level members indexed
+#define WEATHERFLOW_RAW_MEMBERS (16)
+// Number of array elements indexed, across all members
+#define WEATHERFLOW_RAW_ELEMENTS (32)
+// Number of values from rows other than the cache row that are
+// found again without being converted
+#define WEATHERFLOW_RAW_ROW_VALUES (64)
+
+class WeatherFlowRawPacket {
+  public:
+    WeatherFlowRawPacket();
+
+    /* Copy and index a packet. Returns false if it is too large or
+       is not a JSON object */
+    bool parse(const char *packet, size_t length);
+
+    /* Find member, then index1 and index2 within it (-1 if not used)
+       and convert it. If cacheKey is not -1 the value is kept under
+       that key, and row if it is not the cache row, until the next
+       packet is parsed; otherwise it is valid until the next
+       uncached call */
+    JsonVariantConst get(const char *member, int index1, int index2, int cacheKey = -1, int row = -1);
+
+    /* Compare the string value of a member */
+    bool equals(const char *member, const char *value) const;
+
+    /* Number of elements in the array held by member */
+    size_t arraySize(const char *member) const;
+
+    /* Which row of a nested array is cached for quickest lookup,
+       other rows are cached by row and key. Changing it drops cached
+       values */
+    void setCacheRow(size_t row);
+    size_t cacheRow() const { return cachedRow; }
+
+    /* The packet text */
+    const char *text() const { return buffer; }
+    size_t length() const { return textLength; }
+
+  private:
+	struct Member {
+		uint16_t key;
+		uint8_t keyLength;
+		uint16_t value;
+		uint8_t firstElement;
+		uint8_t elementCount;
+		bool nested;	// elements are those of the first row
+	};
+
+	const Member *findMember(const char *member) const;
+	int skipSpace(int pos) const;
+	int skipValue(int pos) const;
+	int skipString(int pos) const;
+	int arrayElement(int pos, int index) const;
+	void indexElements(Member &member);
+	void convert(int pos);
+	uint8_t keep();
+	JsonVariantConst cached(uint16_t position);
+
+	char buffer[WEATHERFLOW_RAW_PACKET_SIZE];
+	size_t textLength;
+
+	Member members[WEATHERFLOW_RAW_MEMBERS];
+	uint8_t memberCount;
+	uint16_t elements[WEATHERFLOW_RAW_ELEMENTS];
+	uint8_t elementCount;
+
+	// Converted values, and where to find them
+	struct RowValue {
+		uint8_t row;
+		uint8_t key;
+		uint8_t position;
+	};
+	JsonDocument cache;
+	JsonDocument scratch;
+	uint16_t cacheCount;
+	uint64_t cachedKeys;	// Keys of the cache row in cache
+	uint8_t keyPositions[64];
+	RowValue rowValues[WEATHERFLOW_RAW_ROW_VALUES];
+	uint8_t rowValueCount;
+	size_t cachedRow;
+};
+#endif
@@ -0,0 +1,164 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowSequence.h"
+#include "WeatherFlowDedupe.h"
+
+WeatherFlowSequence::WeatherFlowSequence() {
+	reset();
+}
+
+void WeatherFlowSequence::reset() {
+	memset(devices, 0, sizeof(devices));
+	memset(evicted, 0, sizeof(evicted));
+	deviceCount = 0;
+	useCounter = 0;
+	nextEvicted = 0;
+}
+
+uint32_t WeatherFlowSequence::deviceKey(const char *serial, uint8_t type) {
+	return WeatherFlowDedupe::hash((uint32_t)type, WeatherFlowDedupe::hash(serial));
+}
+
+// Find the device, or start tracking it. When the table is full the
+// device that has not reported for longest is replaced, and its newest
+// place is kept so that it carries on from there if it is heard again.
+WeatherFlowSequence::Device *WeatherFlowSequence::find(const char *serial, uint8_t type) {
+	if (!serial)
+		serial = "";
+
+	int oldest = 0;
+	for (int i = 0; i < deviceCount; i++) {
+		if (devices[i].type == type && strncmp(devices[i].serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1) == 0)
+			return &devices[i];
+		if (devices[i].lastUsed < devices[oldest].lastUsed)
+			oldest = i;
+	}
+
+	int index;
+	if (deviceCount < WEATHERFLOW_MAX_DEVICES) {
+		index = deviceCount++;
+	} else {
+		index = oldest;
+		Evicted &dropped = evicted[nextEvicted];
+		nextEvicted = (nextEvicted + 1) % WEATHERFLOW_EVICTED_DEVICES;
+		dropped.key = deviceKey(devices[index].serial, devices[index].type);
+		dropped.newestTime = devices[index].newestTime;
+		dropped.newestSequence = devices[index].newestSequence;
+	}
+
+	Device *device = &devices[index];
+	memset(device, 0, sizeof(Device));
+	strncpy(device->serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1);
+	device->type = type;
+
+	// Only the newest place survives being dropped, the counts restart
+	uint32_t key = deviceKey(serial, type);
+	for (int i = 0; i < WEATHERFLOW_EVICTED_DEVICES; i++) {
+		if (evicted[i].key == key) {
+			device->newestTime = evicted[i].newestTime;
+			device->newestSequence = evicted[i].newestSequence;
+			device->window = 1;
+			evicted[i].key = 0;
+			break;
+		}
+	}
+	return device;
+}
+
+// Start again from this packet, forgetting the places before it
+WeatherFlowSequence::Result WeatherFlowSequence::restart(WeatherFlowSequence::Device *device, uint32_t time, int32_t sequence) {
+	device->received++;
+	device->newestTime = time;
+	device->newestSequence = sequence;
+	device->window = 1;
+	device->rejects = 0;
+	return Accepted;
+}
+
+WeatherFlowSequence::Result WeatherFlowSequence::check(const char *serial, uint8_t type, uint32_t time, uint32_t interval, int32_t sequence) {
+	Device *device = find(serial, type);
+	device->lastUsed = ++useCounter;
+
+	// The first packet, unless the device was dropped and heard again
+	if (device->received == 0 && device->window == 0)
+		return restart(device, time, sequence);
+
+	// How many places ahead of the newest packet this one is
+	bool counted = true;
+	int32_t ahead;
+	if (sequence >= 0) {
+		ahead = sequence - (int32_t)device->newestSequence;
+		// The hub restarted and its sequence began again
+		if (ahead <= 0 && time > device->newestTime)
+			return restart(device, time, sequence);
+	} else if (interval > 0) {
+		int32_t delta = (int32_t)(time - device->newestTime);
+		ahead = (delta + (int32_t)(delta < 0 ? -(interval / 2) : interval / 2)) / (int32_t)interval;
+		if (ahead == 0 && delta > 0)
+			ahead = 1;
+	} else {
+		counted = false;
+		ahead = time > device->newestTime ? 1 : time < device->newestTime ? -WEATHERFLOW_REORDER_WINDOW : 0;
+	}
+
+	// Too far from the newest packet to be a gap or a late packet,
+	// the clock or the newest packet was wrong
+	if (counted && (ahead > WEATHERFLOW_RESYNC_PLACES || ahead < -WEATHERFLOW_RESYNC_PLACES)) {
+		device->resyncs++;
+		return restart(device, time, sequence);
+	}
+
+	if (ahead > 0) {
+		if (counted)
+			device->lost += ahead - 1;
+		if (ahead >= WEATHERFLOW_REORDER_WINDOW)
+			device->window = 1;
+		else
+			device->window = (device->window << ahead) | 1;
+		device->received++;
+		device->newestTime = time;
+		device->newestSequence = sequence;
+		device->rejects = 0;
+		return Accepted;
+	}
+
+	device->late++;
+	int32_t behind = -ahead;
+	if (counted && behind > 0 && behind < WEATHERFLOW_REORDER_WINDOW) {
+		uint32_t bit = 1UL << behind;
+		if (!(device->window & bit)) {
+			device->window |= bit;
+			device->received++;
+			if (device->lost > 0)
+				device->lost--;
+			device->rejects = 0;
+			return Reordered;
+		}
+	}
+
+	// Every packet has been behind the newest for a while
+	if (++device->rejects >= WEATHERFLOW_RESYNC_REJECTS) {
+		device->resyncs++;
+		return restart(device, time, sequence);
+	}
+	return Rejected;
+}
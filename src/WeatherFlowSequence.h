@@ -0,0 +1,128 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowSequence_H
+#define _WeatherFlowSequence_H
+
+/***
+    Tracks the order of packets from each device so that a packet
+    delayed on the network does not replace a newer one, and counts
+    the packets that never arrive.
+
+    Packets are placed by hub sequence number, or by time divided by
+    the expected interval between packets. The last 32 places are
+    remembered, so a late packet within that window fills the gap it
+    left instead of being counted as lost.
+
+    A packet far ahead of or behind the newest, or a run of rejected
+    packets, restarts tracking of the device from that packet, so a
+    bad timestamp or a clock that steps back cannot lock it out.
+    When the table is full the least recently heard device is dropped;
+    its newest place is remembered for a while so that an old packet
+    cannot be accepted when the device is heard again.
+ */
+#include "Arduino.h"
+
+// Number of devices (per packet type) tracked
+#ifndef WEATHERFLOW_MAX_DEVICES
+#define WEATHERFLOW_MAX_DEVICES (32)
+#endif
+// Number of dropped devices whose newest place is remembered
+#ifndef WEATHERFLOW_EVICTED_DEVICES
+#define WEATHERFLOW_EVICTED_DEVICES (16)
+#endif
+// Longest serial number stored, including terminator
+#ifndef WEATHERFLOW_SERIAL_LENGTH
+#define WEATHERFLOW_SERIAL_LENGTH (16)
+#endif
+// Number of places a late packet can still fill, at most 32
+#ifndef WEATHERFLOW_REORDER_WINDOW
+#define WEATHERFLOW_REORDER_WINDOW (32)
+#endif
+// Places ahead or behind the newest packet that restart tracking
+#ifndef WEATHERFLOW_RESYNC_PLACES
+#define WEATHERFLOW_RESYNC_PLACES (1440)
+#endif
+// Rejected packets in a row that restart tracking
+#ifndef WEATHERFLOW_RESYNC_REJECTS
+#define WEATHERFLOW_RESYNC_REJECTS (8)
+#endif
+
+class WeatherFlowSequence {
+  public:
+    WeatherFlowSequence();
+
+	/* Outcome of checking a packet */
+	enum Result {
+		Accepted,	// Newest packet from the device
+		Reordered,	// Late, but filled a gap in the window
+		Rejected	// Late and outside the window, or repeated
+	};
+
+	/* Statistics kept for each device and packet type */
+	struct Device {
+		char serial[WEATHERFLOW_SERIAL_LENGTH];
+		uint8_t type;
+		uint32_t received;	// Packets accepted or reordered
+		uint32_t lost;		// Packets that have not arrived
+		uint32_t late;		// Packets that arrived after a newer one
+		uint32_t newestTime;
+		uint32_t newestSequence;
+		uint32_t window;	// Bit n set if the packet n places back arrived
+		uint32_t lastUsed;
+		uint32_t rejects;	// Packets rejected since the last accepted
+		uint32_t resyncs;	// Times tracking restarted
+	};
+
+    /* Check a packet from serial of the given type. interval is the
+       expected number of seconds between packets, 0 if they are not
+       periodic. Pass the sequence number if the packet has one, or -1.
+       Gaps are only counted when there is an interval or sequence. */
+    Result check(const char *serial, uint8_t type, uint32_t time, uint32_t interval, int32_t sequence = -1);
+
+    /* Number of devices being tracked */
+    int count() const { return deviceCount; }
+
+    /* Statistics for a tracked device, 0 <= index < count() */
+    const Device& device(int index) const { return devices[index]; }
+
+    /* Forget all devices */
+    void reset();
+
+  private:
+	/* Newest place of a device dropped from the table */
+	struct Evicted {
+		uint32_t key;
+		uint32_t newestTime;
+		uint32_t newestSequence;
+	};
+
+	Device *find(const char *serial, uint8_t type);
+	static uint32_t deviceKey(const char *serial, uint8_t type);
+	Result restart(Device *device, uint32_t time, int32_t sequence);
+
+	Device devices[WEATHERFLOW_MAX_DEVICES];
+	int deviceCount;
+	uint32_t useCounter;
+	Evicted evicted[WEATHERFLOW_EVICTED_DEVICES];
+	int nextEvicted;
+};
+#endif
@@ -123,6 +123,23 @@ const __FlashStringHelper *WeatherFlowStrings::description_P(WeatherFlowData::Ke
 			return F("Radio Status");
 		case WeatherFlowData::Radio_Stats_Network_Id:
 			return F("Radio Network ID");
+			
+		case WeatherFlowData::Rain_Last_Hour:
+			return F("Rain amount over previous hour");
+		case WeatherFlowData::Rain_Last_24_Hours:
+			return F("Rain amount over previous 24 hours");
+		case WeatherFlowData::Rain_Today:
+			return F("Rain amount today");
+		case WeatherFlowData::Rain_Rate:
+			return F("Rain rate");
+		case WeatherFlowData::Rain_Event_Start:
+			return F("Rain event start");
+		case WeatherFlowData::Rain_Event_End:
+			return F("Rain event end");
+		case WeatherFlowData::Rain_Event_Total:
+			return F("Rain amount over event");
+		case WeatherFlowData::Rain_Missed_Minutes:
+			return F("Rain minutes not reported");
 	}
 	return F("");
 }
@@ -146,6 +163,8 @@ const __FlashStringHelper *WeatherFlowStrings::unit_P(WeatherFlowData::Key key)
 		case WeatherFlowData::Radio_Stats_Network_Id:
 			return F("");
 		case WeatherFlowData::Time_Epoch:
+		case WeatherFlowData::Rain_Event_Start:
+		case WeatherFlowData::Rain_Event_End:
 		case WeatherFlowData::Wind_Sample_Interval:
 		case WeatherFlowData::Uptime:
 			return F("seconds");
@@ -174,7 +193,15 @@ const __FlashStringHelper *WeatherFlowStrings::unit_P(WeatherFlowData::Key key)
 		case WeatherFlowData::Solar_Radiation:
 			return F("W/m^2");
 		case WeatherFlowData::Rain_Last_Minute:
+		case WeatherFlowData::Rain_Last_Hour:
+		case WeatherFlowData::Rain_Last_24_Hours:
+		case WeatherFlowData::Rain_Today:
+		case WeatherFlowData::Rain_Event_Total:
 			return F("mm");
+		case WeatherFlowData::Rain_Rate:
+			return F("mm/h");
+		case WeatherFlowData::Rain_Missed_Minutes:
+			return F("minutes");
 		case WeatherFlowData::Battery:
 			return F("voltage");
 		case WeatherFlowData::Report_Interval:
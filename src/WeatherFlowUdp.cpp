@@ -22,29 +22,100 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "WeatherFlowUdp.h"
 
 //#define DEBUG (0)
-#define WEATHERFLOW_UDP_PORT (50222)
 
-WeatherFlowUdp::WeatherFlowUdp() {
+WeatherFlowUdp::WeatherFlowUdp() :
+	relayCount(0)
+	{
 }
 
 WeatherFlowUdp::~WeatherFlowUdp() {
 }
 
-uint8_t WeatherFlowUdp::begin() {
-	return weatherUDP.begin(WEATHERFLOW_UDP_PORT);
+uint8_t WeatherFlowUdp::begin(uint16_t port) {
+	return weatherUDP.begin(port);
 }
 
 void WeatherFlowUdp::update() {
+	WEATHERFLOW_HEAP_SITE(Update);
 	// Process all waiting packets
 	int packetSize = 0;
 	while(packetSize = weatherUDP.parsePacket()) {
-		JsonDocument tempDoc;
-		DeserializationError err = deserializeJson(tempDoc, weatherUDP);
+		// With lazy decoding JSON packets are kept as text
+		if (isLazyDecoding() && packetSize < WEATHERFLOW_RAW_PACKET_SIZE && weatherUDP.peek() == '{') {
+			char buffer[WEATHERFLOW_RAW_PACKET_SIZE];
+			int length = weatherUDP.read(buffer, packetSize);
+			if (length <= 0)
+				continue;
+			buffer[length] = 0;
+			if (processPacket(buffer) == 0 && relayCount)
+				relay(buffer, length);
+			continue;
+		}
+		
+		JsonDocument tempDoc{WEATHERFLOW_ALLOCATOR};
+		DeserializationError err;
+		// WeatherFlow sends JSON objects, relays send MessagePack
+		if (weatherUDP.peek() == '{')
+			err = deserializeJson(tempDoc, weatherUDP);
+		else
+			err = deserializeMsgPack(tempDoc, weatherUDP);
 		if (err) {
-			Serial.print(F("deserializeJson() failed of UDP packet: "));
+			Serial.print(F("deserialize failed of UDP packet: "));
 			Serial.println(err.c_str());
+			continue;
+		}
+		if (processJsonDocument(tempDoc) == 0 && relayCount)
+			relay(tempDoc);
+	}
+	
+	// Notice devices that have stopped reporting
+	checkHealth();
+}
+
+bool WeatherFlowUdp::addRelay(IPAddress address, uint16_t port) {
+	if (relayCount >= WEATHERFLOW_MAX_RELAYS)
+		return false;
+	relayAddresses[relayCount] = address;
+	relayPorts[relayCount] = port;
+	relayCount++;
+	return true;
+}
+
+void WeatherFlowUdp::clearRelays() {
+	relayCount = 0;
+}
+
+// Send the packet text as it was received
+void WeatherFlowUdp::relay(const char *packet, size_t length) {
+	for (int i = 0; i < relayCount; i++) {
+		weatherUDP.beginPacket(relayAddresses[i], relayPorts[i]);
+		weatherUDP.write((const uint8_t*)packet, length);
+		if (!weatherUDP.endPacket()) {
+#ifdef DEBUG
+			Serial.println(F("Failed to relay packet"));
+#endif
+		}
+	}
+}
+
+// Encode the packet once and send the same bytes to every subscriber
+void WeatherFlowUdp::relay(JsonDocument& doc) {
+	uint8_t buffer[WEATHERFLOW_RELAY_BUFFER_SIZE];
+	size_t length = 0;
+	if (measureMsgPack(doc) <= sizeof(buffer))
+		length = serializeMsgPack(doc, buffer, sizeof(buffer));
+
+	for (int i = 0; i < relayCount; i++) {
+		weatherUDP.beginPacket(relayAddresses[i], relayPorts[i]);
+		if (length)
+			weatherUDP.write(buffer, length);
+		else
+			serializeMsgPack(doc, weatherUDP);
+		if (!weatherUDP.endPacket()) {
+#ifdef DEBUG
+			Serial.println(F("Failed to relay packet"));
+#endif
 		}
-		processJsonDocument(tempDoc);
 	}
 }
 
@@ -25,23 +25,54 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 /***
     Creates a UDP listener for WeatherFlow UDP packets 
     and sends them to base class for processing.
+    
+    Can also act as a relay: each packet that is processed is
+    encoded once as MessagePack and sent to a list of local
+    subscribers. A subscriber is another WeatherFlowUdp listening
+    on its own port, which accepts both JSON and MessagePack, so
+    packets are only parsed as JSON once per host. With lazy
+    decoding the JSON text is relayed unchanged instead.
  */
 #include "Arduino.h"
 #include "WeatherFlowData.h"
 #include <WiFiUdp.h>
 
+#define WEATHERFLOW_UDP_PORT (50222)
+// Number of subscribers a relay can send to
+#define WEATHERFLOW_MAX_RELAYS (4)
+// Largest MessagePack packet encoded once for all subscribers.
+// Larger packets are encoded for each subscriber.
+#define WEATHERFLOW_RELAY_BUFFER_SIZE (512)
+
 class WeatherFlowUdp : public WeatherFlowData {
   public:
     WeatherFlowUdp();
     ~WeatherFlowUdp();
     
-    /* Start listening for packets */
-    uint8_t begin();
+    /* Start listening for packets, on the WeatherFlow broadcast
+       port unless this is a relay subscriber */
+    uint8_t begin(uint16_t port = WEATHERFLOW_UDP_PORT);
 
     /* Process any pending packets */
     void update();
     
+    /* Send every processed packet, as MessagePack, to address:port.
+       Returns false if there are already WEATHERFLOW_MAX_RELAYS.
+       Do not relay to the WeatherFlow broadcast port. */
+    bool addRelay(IPAddress address, uint16_t port);
+    
+    /* Stop relaying to all subscribers */
+    void clearRelays();
+    
   private:
+	void relay(JsonDocument& doc);
+	void relay(const char *packet, size_t length);
+
 	  WiFiUDP weatherUDP;
+	  
+	  // Subscribers to relay packets to
+	  IPAddress relayAddresses[WEATHERFLOW_MAX_RELAYS];
+	  uint16_t relayPorts[WEATHERFLOW_MAX_RELAYS];
+	  int relayCount;
 };
 #endif
@@ -0,0 +1,207 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowWatchdog.h"
+#include "WeatherFlowDedupe.h"
+
+#define WHEEL_MASK (WEATHERFLOW_WHEEL_SLOTS - 1)
+
+WeatherFlowWatchdog::WeatherFlowWatchdog() :
+	staleCallback(0),
+	staleContext(0)
+	{
+	reset();
+}
+
+void WeatherFlowWatchdog::reset() {
+	memset(devices, 0, sizeof(devices));
+	for (int i = 0; i < WEATHERFLOW_WATCHDOG_DEVICES; i++) {
+		timers[i].bucket = -1;
+		chains[i] = -1;
+		chainNext[i] = -1;
+	}
+	for (int i = 0; i < WEATHERFLOW_WHEEL_LEVELS * WEATHERFLOW_WHEEL_SLOTS; i++)
+		buckets[i] = -1;
+	deviceCount = 0;
+	clock = 0;
+	clockMillis = 0;
+	started = false;
+}
+
+void WeatherFlowWatchdog::registerStale(WeatherFlowWatchdog::EStaleFunction callback, void* context) {
+	staleCallback = callback;
+	staleContext = context;
+}
+
+uint32_t WeatherFlowWatchdog::deviceKey(const char *serial, uint8_t type) {
+	return WeatherFlowDedupe::hash((uint32_t)type, WeatherFlowDedupe::hash(serial));
+}
+
+// Find the device, or start watching it. When the table is full the
+// device that has not reported for longest is replaced.
+int WeatherFlowWatchdog::find(const char *serial, uint8_t type, uint32_t now) {
+	if (!serial)
+		serial = "";
+
+	uint32_t key = deviceKey(serial, type);
+	int chain = key % WEATHERFLOW_WATCHDOG_DEVICES;
+	for (int i = chains[chain]; i >= 0; i = chainNext[i]) {
+		if (keys[i] == key && devices[i].type == type && strncmp(devices[i].serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1) == 0)
+			return i;
+	}
+
+	int index;
+	if (deviceCount < WEATHERFLOW_WATCHDOG_DEVICES) {
+		index = deviceCount++;
+	} else {
+		index = 0;
+		for (int i = 1; i < deviceCount; i++) {
+			if (now - devices[i].lastSeen > now - devices[index].lastSeen)
+				index = i;
+		}
+		unlink(index);
+		unhash(index);
+	}
+
+	Device *device = &devices[index];
+	memset(device, 0, sizeof(Device));
+	strncpy(device->serial, serial, WEATHERFLOW_SERIAL_LENGTH - 1);
+	device->type = type;
+	keys[index] = key;
+	chainNext[index] = chains[chain];
+	chains[chain] = index;
+	return index;
+}
+
+// Take a device out of its hash chain
+void WeatherFlowWatchdog::unhash(int index) {
+	int16_t *link = &chains[keys[index] % WEATHERFLOW_WATCHDOG_DEVICES];
+	while (*link >= 0) {
+		if (*link == index) {
+			*link = chainNext[index];
+			break;
+		}
+		link = &chainNext[*link];
+	}
+	chainNext[index] = -1;
+}
+
+bool WeatherFlowWatchdog::seen(const char *serial, uint8_t type, uint32_t interval, uint32_t now) {
+	advance(now);
+	int index = find(serial, type, now);
+	Device *device = &devices[index];
+	bool recovered = device->stale;
+	device->stale = false;
+	device->interval = interval;
+	device->lastSeen = now;
+
+	unlink(index);
+	if (interval > 0) {
+		timers[index].deadline = clock + interval * WEATHERFLOW_STALE_INTERVALS;
+		schedule(index);
+	}
+	return recovered;
+}
+
+void WeatherFlowWatchdog::advance(uint32_t now) {
+	if (!started) {
+		started = true;
+		clockMillis = now;
+		return;
+	}
+	while (now - clockMillis >= 1000) {
+		clockMillis += 1000;
+		tick();
+	}
+}
+
+// Put a device in the lowest level whose turn covers its deadline.
+// Deadlines beyond the top level go in its last slot and are placed
+// again when that slot comes round.
+void WeatherFlowWatchdog::schedule(int index) {
+	uint32_t deadline = timers[index].deadline;
+	int level = 0;
+	uint32_t slot = 0;
+	for (; level < WEATHERFLOW_WHEEL_LEVELS; level++) {
+		int shift = level * WEATHERFLOW_WHEEL_BITS;
+		if ((deadline >> shift) - (clock >> shift) < WEATHERFLOW_WHEEL_SLOTS) {
+			slot = deadline >> shift;
+			break;
+		}
+	}
+	if (level == WEATHERFLOW_WHEEL_LEVELS) {
+		level--;
+		slot = (clock >> (level * WEATHERFLOW_WHEEL_BITS)) + WHEEL_MASK;
+	}
+	link(index, level * WEATHERFLOW_WHEEL_SLOTS + (slot & WHEEL_MASK));
+}
+
+void WeatherFlowWatchdog::link(int index, int bucket) {
+	Timer *timer = &timers[index];
+	timer->bucket = bucket;
+	timer->prev = -1;
+	timer->next = buckets[bucket];
+	if (timer->next >= 0)
+		timers[timer->next].prev = index;
+	buckets[bucket] = index;
+}
+
+void WeatherFlowWatchdog::unlink(int index) {
+	Timer *timer = &timers[index];
+	if (timer->bucket < 0)
+		return;
+	if (timer->prev >= 0)
+		timers[timer->prev].next = timer->next;
+	else
+		buckets[timer->bucket] = timer->next;
+	if (timer->next >= 0)
+		timers[timer->next].prev = timer->prev;
+	timer->bucket = -1;
+}
+
+// Move on one second. When a level completes a turn, the next slot
+// of the level above is moved down, then the current slot expires.
+void WeatherFlowWatchdog::tick() {
+	clock++;
+	for (int level = 1; level < WEATHERFLOW_WHEEL_LEVELS; level++) {
+		int shift = level * WEATHERFLOW_WHEEL_BITS;
+		if (clock & ((1UL << shift) - 1))
+			break;
+		expire(level * WEATHERFLOW_WHEEL_SLOTS + ((clock >> shift) & WHEEL_MASK));
+	}
+	expire(clock & WHEEL_MASK);
+}
+
+// Empty a slot: devices past their deadline become stale, the rest
+// are placed again lower down
+void WeatherFlowWatchdog::expire(int bucket) {
+	int index;
+	while ((index = buckets[bucket]) >= 0) {
+		unlink(index);
+		if ((int32_t)(timers[index].deadline - clock) > 0) {
+			schedule(index);
+			continue;
+		}
+		devices[index].stale = true;
+		if (staleCallback)
+			staleCallback(devices[index], staleContext);
+	}
+}
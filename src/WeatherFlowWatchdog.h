@@ -0,0 +1,130 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowWatchdog_H
+#define _WeatherFlowWatchdog_H
+
+/***
+    Tracks when each device last reported each packet type, and
+    notices when one stops reporting.
+
+    Every device has a deadline, WEATHERFLOW_STALE_INTERVALS times
+    its expected interval after the last packet. Deadlines are held
+    in a hierarchical timer wheel: WEATHERFLOW_WHEEL_LEVELS wheels of
+    WEATHERFLOW_WHEEL_SLOTS slots, each level counting in steps as
+    long as a full turn of the level below. Each second only the
+    current slot is examined, and upper level slots are moved down a
+    level when their time comes, so the cost does not grow with the
+    number of devices.
+
+    Devices are found through a hash table. At most
+    WEATHERFLOW_WATCHDOG_DEVICES devices and packet types are watched;
+    beyond that the least recently heard is dropped, and a dropped
+    device is never reported stale.
+ */
+#include "Arduino.h"
+#include "WeatherFlowSequence.h"
+
+// Slots in each level of the timer wheel, as a power of 2
+#define WEATHERFLOW_WHEEL_BITS (6)
+#define WEATHERFLOW_WHEEL_SLOTS (1 << WEATHERFLOW_WHEEL_BITS)
+// Levels of the timer wheel. Three levels of 64 slots cover
+// deadlines up to 3 days ahead, longer ones are reinserted.
+#define WEATHERFLOW_WHEEL_LEVELS (3)
+// Missed intervals before a device is stale
+#define WEATHERFLOW_STALE_INTERVALS (3)
+// Devices (per packet type) watched, at most 32767
+#ifndef WEATHERFLOW_WATCHDOG_DEVICES
+#define WEATHERFLOW_WATCHDOG_DEVICES (64)
+#endif
+
+class WeatherFlowWatchdog {
+  public:
+    WeatherFlowWatchdog();
+
+	/* Health of each device and packet type */
+	struct Device {
+		char serial[WEATHERFLOW_SERIAL_LENGTH];
+		uint8_t type;
+		bool stale;
+		uint32_t interval;	// Expected seconds between packets
+		uint32_t lastSeen;	// millis() of the last packet
+	};
+
+	/* Called when a device becomes stale */
+	typedef std::function<void(const Device& device, void* context)> EStaleFunction;
+	void registerStale(EStaleFunction callback, void* context = 0);
+
+	/* Record a packet from serial of the given type at millis() now.
+	   interval is the expected number of seconds between packets, 0
+	   if the type is not periodic and never goes stale. Returns true
+	   if the device had been stale. */
+	bool seen(const char *serial, uint8_t type, uint32_t interval, uint32_t now);
+
+	/* Move the wheel on to millis() now, calling the stale callback
+	   for each device whose deadline has passed */
+	void advance(uint32_t now);
+
+	/* Number of devices being watched */
+	int count() const { return deviceCount; }
+
+	/* A watched device, 0 <= index < count() */
+	const Device& device(int index) const { return devices[index]; }
+
+	/* Forget all devices */
+	void reset();
+
+  private:
+	// Position of a device in the wheel
+	struct Timer {
+		uint32_t deadline;	// In wheel seconds
+		int16_t bucket;		// level * WEATHERFLOW_WHEEL_SLOTS + slot, -1 if not in the wheel
+		int16_t next;
+		int16_t prev;
+	};
+
+	int find(const char *serial, uint8_t type, uint32_t now);
+	static uint32_t deviceKey(const char *serial, uint8_t type);
+	void unhash(int index);
+	void schedule(int index);
+	void link(int index, int bucket);
+	void unlink(int index);
+	void tick();
+	void expire(int bucket);
+
+	Device devices[WEATHERFLOW_WATCHDOG_DEVICES];
+	Timer timers[WEATHERFLOW_WATCHDOG_DEVICES];
+	int deviceCount;
+
+	// Hash chains of devices
+	uint32_t keys[WEATHERFLOW_WATCHDOG_DEVICES];
+	int16_t chains[WEATHERFLOW_WATCHDOG_DEVICES];
+	int16_t chainNext[WEATHERFLOW_WATCHDOG_DEVICES];
+
+	int16_t buckets[WEATHERFLOW_WHEEL_LEVELS * WEATHERFLOW_WHEEL_SLOTS];
+	uint32_t clock;		// Seconds since the wheel started
+	uint32_t clockMillis;	// millis() when clock last moved on
+	bool started;
+
+	EStaleFunction staleCallback;
+	void* staleContext;
+};
+#endif
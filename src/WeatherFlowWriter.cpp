@@ -0,0 +1,323 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WeatherFlowWriter.h"
+#include "WeatherFlowStrings.h"
+
+//#define DEBUG (0)
+
+// Row used to mean whatever getValue(obj, key) returns
+#define CURRENT_ROW ((size_t)-1)
+
+static const char *MEASUREMENT = "weatherflow_";
+
+WeatherFlowWriter::WeatherFlowWriter(char *buffer, size_t size, WeatherFlowWriter::Format format) :
+	buffer(buffer),
+	size(size),
+	used(0),
+	overflow(false),
+	format(format),
+	headerWritten(false),
+	waiting(0),
+	batchSize(0),
+	flushInterval(0),
+	oldestMillis(0),
+	flushCallback(0),
+	flushContext(0)
+	{
+	if (size)
+		buffer[0] = '\0';
+}
+
+WeatherFlowWriter::~WeatherFlowWriter() {
+}
+
+void WeatherFlowWriter::registerFlush(WeatherFlowWriter::EFlushFunction flush, void* context) {
+	flushCallback = flush;
+	flushContext = context;
+}
+
+void WeatherFlowWriter::setBatchSize(size_t records) {
+	batchSize = records;
+}
+
+void WeatherFlowWriter::setFlushInterval(unsigned long ms) {
+	flushInterval = ms;
+}
+
+bool WeatherFlowWriter::write(WeatherFlowData &data, WeatherFlowData::Object obj) {
+	return write(data, obj, CURRENT_ROW);
+}
+
+bool WeatherFlowWriter::write(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row) {
+	if (!data.hasObject(obj))
+		return false;
+
+	// If the record does not fit, flush and try once more
+	if (!writeRecord(data, obj, row)) {
+		flush();
+		if (!writeRecord(data, obj, row)) {
+#ifdef DEBUG
+			Serial.println(F("WeatherFlowWriter buffer too small for record"));
+#endif
+			return false;
+		}
+	}
+
+	if (waiting++ == 0)
+		oldestMillis = millis();
+	if (batchSize && waiting >= batchSize)
+		flush();
+	else
+		update();
+	return true;
+}
+
+void WeatherFlowWriter::update() {
+	if (waiting && flushInterval && millis() - oldestMillis >= flushInterval)
+		flush();
+}
+
+void WeatherFlowWriter::flush() {
+	if (waiting && flushCallback)
+		flushCallback(buffer, used, flushContext);
+	used = 0;
+	waiting = 0;
+	if (size)
+		buffer[0] = '\0';
+}
+
+// Write a complete record, or nothing if it does not fit
+bool WeatherFlowWriter::writeRecord(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row) {
+	size_t start = used;
+	bool header = headerWritten;
+	overflow = false;
+
+	if (format == CSV)
+		writeCSV(data, obj, row);
+	else
+		writeLineProtocol(data, obj, row);
+
+	if (overflow) {
+		used = start;
+		headerWritten = header;
+	}
+	if (size)
+		buffer[used < size ? used : size - 1] = '\0';
+	return !overflow;
+}
+
+static JsonVariantConst valueOf(WeatherFlowData &data, WeatherFlowData::Object obj, WeatherFlowData::Key key, size_t row) {
+	if (row == CURRENT_ROW)
+		return data.getValue(obj, key);
+	return data.getValue(obj, key, row);
+}
+
+void WeatherFlowWriter::writeLineProtocol(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row) {
+	// One measurement per object type, so each field keeps one type
+	// across records; hubs and devices report firmware differently
+	append(MEASUREMENT);
+	append(WeatherFlowData::objectType(obj));
+	JsonVariantConst serial = valueOf(data, obj, WeatherFlowData::Serial_Number, row);
+	if (serial.is<const char*>()) {
+		append(",serial=");
+		appendEscaped(serial, ", =");
+	}
+	JsonVariantConst hub = valueOf(data, obj, WeatherFlowData::Hub_Serial_Number, row);
+	if (hub.is<const char*>()) {
+		append(",hub=");
+		appendEscaped(hub, ", =");
+	}
+
+	// Fields
+	bool first = true;
+	for (int keyInt = WeatherFlowData::Time_Epoch + 1; keyInt != WeatherFlowData::Last_Value; keyInt++) {
+		WeatherFlowData::Key key = static_cast<WeatherFlowData::Key>(keyInt);
+		JsonVariantConst value = valueOf(data, obj, key, row);
+		if (value.isNull())
+			continue;
+		append(first ? ' ' : ',');
+		appendName(WeatherFlowStrings::description_P(key));
+		append('=');
+		appendValue(value, true);
+		first = false;
+	}
+	// A line needs at least one field
+	if (first)
+		append(" received=1");
+
+	JsonVariantConst time = valueOf(data, obj, WeatherFlowData::Time_Epoch, row);
+	if (!time.isNull()) {
+		append(' ');
+		appendUnsigned(time.as<uint32_t>());
+	}
+	append('\n');
+}
+
+void WeatherFlowWriter::writeCSV(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row) {
+	if (!headerWritten) {
+		append("time,type,serial,key,value\n");
+		headerWritten = true;
+	}
+
+	uint32_t time = valueOf(data, obj, WeatherFlowData::Time_Epoch, row).as<uint32_t>();
+	JsonVariantConst serial = valueOf(data, obj, WeatherFlowData::Serial_Number, row);
+	for (int keyInt = WeatherFlowData::Time_Epoch + 1; keyInt != WeatherFlowData::Last_Value; keyInt++) {
+		WeatherFlowData::Key key = static_cast<WeatherFlowData::Key>(keyInt);
+		JsonVariantConst value = valueOf(data, obj, key, row);
+		if (value.isNull())
+			continue;
+		appendUnsigned(time);
+		append(',');
+		append(WeatherFlowData::objectType(obj));
+		append(',');
+		appendQuoted(serial);
+		append(',');
+		appendName(WeatherFlowStrings::description_P(key));
+		append(',');
+		appendValue(value, false);
+		append('\n');
+	}
+}
+
+void WeatherFlowWriter::appendValue(JsonVariantConst value, bool lineProtocol) {
+	if (value.is<const char*>()) {
+		if (lineProtocol) {
+			append('"');
+			appendEscaped(value, "\"\\");
+			append('"');
+		} else {
+			appendQuoted(value);
+		}
+	} else if (value.is<int32_t>()) {
+		appendInteger(value.as<int32_t>());
+	} else if (value.is<uint32_t>()) {
+		appendUnsigned(value.as<uint32_t>());
+	} else {
+		appendFloat(value.as<double>());
+	}
+}
+
+void WeatherFlowWriter::append(char c) {
+	// Always leave room for a terminator
+	if (used + 1 < size)
+		buffer[used++] = c;
+	else
+		overflow = true;
+}
+
+void WeatherFlowWriter::append(const char *str) {
+	if (!str)
+		return;
+	while (*str)
+		append(*str++);
+}
+
+// Copy str, putting a backslash before any character in special
+void WeatherFlowWriter::appendEscaped(const char *str, const char *special) {
+	if (!str)
+		return;
+	while (*str) {
+		if (strchr(special, *str))
+			append('\\');
+		append(*str++);
+	}
+}
+
+// A CSV field in quotes, with quotes inside it doubled
+void WeatherFlowWriter::appendQuoted(const char *str) {
+	append('"');
+	while (str && *str) {
+		if (*str == '"')
+			append('"');
+		append(*str++);
+	}
+	append('"');
+}
+
+// Key names are their description, with spaces replaced
+void WeatherFlowWriter::appendName(const __FlashStringHelper *name) {
+	PGM_P p = reinterpret_cast<PGM_P>(name);
+	char c;
+	while ((c = pgm_read_byte(p++)))
+		append(c == ' ' ? '_' : c);
+}
+
+void WeatherFlowWriter::appendUnsigned(uint32_t value) {
+	char digits[10];
+	int count = 0;
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (count)
+		append(digits[--count]);
+}
+
+void WeatherFlowWriter::appendInteger(int32_t value) {
+	if (value < 0) {
+		append('-');
+		appendUnsigned((uint32_t)0 - (uint32_t)value);
+	} else {
+		appendUnsigned(value);
+	}
+}
+
+// Fixed point with trailing zeros removed, e.g. 22.37 or 0.5
+void WeatherFlowWriter::appendFloat(double value) {
+	if (isnan(value) || isinf(value)) {
+		append('0');
+		return;
+	}
+	if (value < 0) {
+		append('-');
+		value = -value;
+	}
+
+	uint32_t scale = 1;
+	for (int i = 0; i < WEATHERFLOW_WRITER_DECIMALS; i++)
+		scale *= 10;
+
+	if (value >= 4294967295.0 / scale) {
+		// Too large for fixed point, no WeatherFlow value gets here
+		appendUnsigned(value >= 4294967295.0 ? 4294967295UL : (uint32_t)value);
+		return;
+	}
+
+	uint32_t fixed = (uint32_t)(value * scale + 0.5);
+	appendUnsigned(fixed / scale);
+	uint32_t fraction = fixed % scale;
+	if (fraction == 0)
+		return;
+
+	// Digits after the point, without trailing zeros
+	char digits[WEATHERFLOW_WRITER_DECIMALS];
+	int count = WEATHERFLOW_WRITER_DECIMALS;
+	for (int i = count - 1; i >= 0; i--) {
+		digits[i] = '0' + fraction % 10;
+		fraction /= 10;
+	}
+	while (digits[count - 1] == '0')
+		count--;
+	append('.');
+	for (int i = 0; i < count; i++)
+		append(digits[i]);
+}
@@ -0,0 +1,122 @@
+/*
+Copyright 2023 David Carson (dacarson at gmail)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this
+software and associated documentation files (the “Software”), to deal in the
+Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the
+following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WeatherFlowWriter_H
+#define _WeatherFlowWriter_H
+
+/***
+    Writes WeatherFlow objects as InfluxDB line protocol or CSV into
+    a buffer provided by the caller. Records are batched in the
+    buffer, and handed to a flush callback when the buffer is full,
+    enough records are waiting, or the oldest record is old enough.
+
+    Numbers are formatted directly into the buffer; no sprintf and
+    no heap allocations.
+
+    Line protocol records look like:
+      weatherflow_obs_st,serial=ST-00000512,hub=HB-00013030 Wind_Lull=0.18,... 1588948614
+    Each object type is its own measurement. All numbers are written
+    as floats, so a field that is sometimes a whole number keeps one
+    type. Timestamps are in seconds, so write with precision=s.
+
+    CSV records are one line per value, with the serial number and
+    string values in quotes:
+      time,type,serial,key,value
+      1588948614,hub_status,"HB-00013030",Reset_Flags,"BOR,PIN,POR"
+ */
+#include "Arduino.h"
+#include "WeatherFlowData.h"
+
+// Digits written after the decimal point
+#define WEATHERFLOW_WRITER_DECIMALS (4)
+
+class WeatherFlowWriter {
+  public:
+	/* Supported output formats */
+	enum Format {
+		Line_Protocol,
+		CSV
+	};
+
+    WeatherFlowWriter(char *buffer, size_t size, Format format = Line_Protocol);
+    ~WeatherFlowWriter();
+
+	// Flush function prototype is of the form:
+	//    void flush(const char* data, size_t length, void* context)
+	// data is only valid during the call.
+	typedef std::function<void(const char* data, size_t length, void* context)> EFlushFunction;
+	void registerFlush(EFlushFunction flush, void* context = 0);
+
+	/* Flush once this many records are waiting, 0 to only flush when full */
+	void setBatchSize(size_t records);
+
+	/* Flush once the oldest waiting record is this many milliseconds
+	   old, 0 to only flush when full. Checked by write() and update() */
+	void setFlushInterval(unsigned long ms);
+
+	/* Append the object, as returned by data.getValue(obj, key).
+	   Returns false if it does not fit in the buffer, even empty */
+	bool write(WeatherFlowData &data, WeatherFlowData::Object obj);
+
+	/* Append a specific row of an observation */
+	bool write(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row);
+
+	/* Flush if the flush interval has passed */
+	void update();
+
+	/* Hand all waiting records to the flush function */
+	void flush();
+
+	/* Number of bytes and records waiting */
+	size_t length() const { return used; }
+	size_t records() const { return waiting; }
+
+  private:
+	bool writeRecord(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row);
+	void writeLineProtocol(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row);
+	void writeCSV(WeatherFlowData &data, WeatherFlowData::Object obj, size_t row);
+	void appendValue(JsonVariantConst value, bool lineProtocol);
+
+	void append(char c);
+	void append(const char *str);
+	void appendEscaped(const char *str, const char *special);
+	void appendQuoted(const char *str);
+	void appendName(const __FlashStringHelper *name);
+	void appendUnsigned(uint32_t value);
+	void appendInteger(int32_t value);
+	void appendFloat(double value);
+
+	char *buffer;
+	size_t size;
+	size_t used;
+	bool overflow;
+	Format format;
+	bool headerWritten;
+
+	size_t waiting;
+	size_t batchSize;
+	unsigned long flushInterval;
+	unsigned long oldestMillis;
+
+	EFlushFunction flushCallback;
+	void *flushContext;
+};
+#endif